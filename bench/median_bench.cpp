@@ -0,0 +1,99 @@
+// Times the two order-statistics trees that can keep the median (--median=treap and
+//   --median=btree) the way the median tree is used: every vertex gets a degree from 1 to
+//   20 at random, and then each operation moves a random vertex's degree up or down by one
+//   and looks up the median again.
+//
+//   median_bench [operations [vertices...]]
+//
+// With no arguments, 2,000,000 operations on 10^4, 10^6 and 10^7 vertices. The random
+//   numbers are seeded the same way every run, so both trees see the same changes.
+
+#include "median_degree.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+    using DegName = MedianDegreeStruct::DegName;
+    using VertexId = MedianDegreeStruct::VertexId;
+
+    // the median, as MedianDegreeStruct works it out from a tree
+    template <class Tree>
+    double medianOf(const Tree &tree)
+    {
+        int n = tree.size();
+        if (n % 2) return tree.orderStatistic(n/2).first.first;
+        return 0.5 * (tree.orderStatistic(n/2 - 1).first.first + tree.orderStatistic(n/2).first.first);
+    }
+
+    template <class Tree>
+    void fill(Tree &tree, const std::vector<int> &degrees)
+    {
+        for (VertexId v = 0; v < degrees.size(); v++) tree.insert(DegName(degrees[v], v), 0);
+    }
+
+    // the treap can be built from sorted keys in linear time, and its shape only depends
+    //   on the priorities anyway
+    void fill(MedianDegreeStruct::MedianMap &tree, const std::vector<int> &degrees)
+    {
+        std::vector<std::pair<DegName,int>> items;
+        items.reserve(degrees.size());
+        for (VertexId v = 0; v < degrees.size(); v++) items.push_back(std::make_pair(DegName(degrees[v], v), 0));
+        std::sort(items.begin(), items.end());
+        tree.assign(items.begin(), items.end());
+    }
+
+    // nanoseconds per degree change and median lookup
+    template <class Tree>
+    double run(std::vector<int> degrees, long operations)
+    {
+        Tree tree;
+        fill(tree, degrees);
+
+        std::mt19937_64 rng(12345);
+        std::uniform_int_distribution<VertexId> pick(0, static_cast<VertexId>(degrees.size() - 1));
+        double sum = 0; // so that the lookups can't be optimized away
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < operations; i++) {
+            VertexId v = pick(rng);
+            int d = degrees[v];
+            int to = d == 1 || (rng() & 1) ? d + 1 : d - 1;
+            tree.rekey(DegName(d, v), DegName(to, v));
+            degrees[v] = to;
+            sum += medianOf(tree);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if (sum < 0) std::printf("%f\n", sum);
+        return std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    long operations = argc > 1 ? std::atol(argv[1]) : 2000000;
+    std::vector<long> sizes;
+    for (int i = 2; i < argc; i++) sizes.push_back(std::atol(argv[i]));
+    if (sizes.empty()) sizes = {10000, 1000000, 10000000};
+    if (operations <= 0 || std::find_if(sizes.begin(), sizes.end(), [](long n) { return n <= 0; }) != sizes.end()) {
+        std::fprintf(stderr, "usage: %s [operations [vertices...]]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-12s %12s %12s\n", "vertices", "B+tree", "treap");
+    for (long n : sizes) {
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<int> degree(1, 20);
+        std::vector<int> degrees(n);
+        for (int &d : degrees) d = degree(rng);
+
+        std::srand(1); // the treap's priorities
+        double btree = run<MedianDegreeStruct::MedianBTree>(degrees, operations);
+        double treap = run<MedianDegreeStruct::MedianMap>(degrees, operations);
+        std::printf("%-12ld %9.0f ns %9.0f ns\n", n, btree, treap);
+    }
+    return 0;
+}
@@ -0,0 +1,274 @@
+#ifndef reference_treaps_hpp
+#define reference_treaps_hpp
+
+#include <memory>
+#include <utility>
+#include "treap.hpp"
+
+// Frozen copies of the treap's split and merge as they used to be, for treap_bench to time
+//   next to the current ones; the program doesn't use them. Only what the benchmark needs
+//   is kept (insert, remove, split, merge and, for the arena one, rekey), otherwise as it was.
+namespace reference {
+
+// The original: nodes own their children through unique_ptrs, and split and merge recurse,
+//   cutting subtrees off into temporary tree objects on every level. Insert and remove
+//   split and merge the whole tree.
+template <class Key, class Value, class Priority>
+class PointerTreap {
+    struct node {
+        Key key;
+        Value val;
+        Priority priority;
+        std::unique_ptr<node> left;
+        std::unique_ptr<node> right;
+        int size;
+
+        node(const Key& k, const Value& v, Priority p) : key(k), val(v), priority(p), size(1) {}
+    };
+    static int sz(const std::unique_ptr<node> &t) { return t ? t->size : 0; }
+
+    std::unique_ptr<node> root;
+
+    explicit PointerTreap(std::unique_ptr<node> &&other) : root(std::move(other)) {}
+public:
+    PointerTreap() = default;
+    PointerTreap(PointerTreap &&) = default;
+    PointerTreap &operator=(PointerTreap &&) = default;
+
+    PointerTreap &insert(const Key& k, const Value &data, Priority p = Priority())
+    {
+        PointerTreap temp(std::unique_ptr<node>(new node(k, data, p)));
+        auto right_tree = split(k);
+        merge(temp);
+        merge(right_tree);
+        return *this;
+    }
+
+    PointerTreap &remove(const Key& k)
+    {
+        auto right_tree = split(k);
+        split(k, /* inclusive */ false);
+        merge(right_tree);
+        return *this;
+    }
+
+    PointerTreap &merge(PointerTreap &rhs)
+    {
+        if (empty()) {
+            *this = std::move(rhs);
+        }
+        if (!rhs.empty()) {
+            if (root->priority < rhs.root->priority) {
+                PointerTreap temp(std::move(rhs.root->left));
+                merge(temp);
+                rhs.root->left = std::move(root);
+                rhs.root->size = sz(rhs.root->left) + 1 + sz(rhs.root->right);
+                *this = std::move(rhs);
+            } else {
+                PointerTreap temp(std::move(root->right));
+                temp.merge(rhs);
+                root->right = std::move(temp.root);
+                root->size = sz(root->left) + 1 + sz(root->right);
+            }
+        }
+        return *this;
+    }
+
+    PointerTreap split(const Key& index, bool inclusive = true)
+    {
+        PointerTreap res;
+        if (!empty()) {
+            bool rootIsLess = inclusive ? (root->key <= index) : (root->key < index);
+            if (rootIsLess) {
+                PointerTreap temp(std::move(root->right));
+                res = temp.split(index, inclusive);
+                root->right = std::move(temp.root);
+                root->size = sz(root->left) + 1 + sz(root->right);
+            } else {
+                PointerTreap temp(std::move(root->left));
+                res = temp.split(index, inclusive);
+                root->left = std::move(res.root);
+                root->size = sz(root->left) + 1 + sz(root->right);
+                res = std::move(*this);
+                *this = std::move(temp);
+            }
+        }
+        return res;
+    }
+
+    int size() const { return sz(root); }
+    bool empty() const { return !root; }
+};
+
+// The first arena version: nodes in a slab linked by 32-bit indices, as now, but split and
+//   merge still recurse, and insert and remove still split and merge the whole tree.
+template <class Key, class Value, class Priority, template <class> class Arena = SlabArena>
+class RecursiveArenaTreap {
+    using node = TreapNode<Key, Value, Priority>;
+
+    Arena<node> nodes;
+    TreapIndex root;
+
+    int sz(TreapIndex t) const { return t == treapNull ? 0 : nodes[t].size; }
+    void updateSize(TreapIndex t) { nodes[t].size = sz(nodes[t].left) + 1 + sz(nodes[t].right); }
+
+    TreapIndex merge(TreapIndex lhs, TreapIndex rhs)
+    {
+        if (lhs == treapNull) return rhs;
+        if (rhs == treapNull) return lhs;
+        if (nodes[lhs].priority < nodes[rhs].priority) {
+            TreapIndex merged = merge(lhs, nodes[rhs].left);
+            nodes[rhs].left = merged;
+            updateSize(rhs);
+            return rhs;
+        } else {
+            TreapIndex merged = merge(nodes[lhs].right, rhs);
+            nodes[lhs].right = merged;
+            updateSize(lhs);
+            return lhs;
+        }
+    }
+
+    void split(TreapIndex t, const Key& index, bool inclusive, TreapIndex &lhs, TreapIndex &rhs)
+    {
+        if (t == treapNull) {
+            lhs = rhs = treapNull;
+            return;
+        }
+        bool rootIsLess = inclusive ? (nodes[t].key <= index) : (nodes[t].key < index);
+        TreapIndex l, r;
+        if (rootIsLess) {
+            split(nodes[t].right, index, inclusive, l, r);
+            nodes[t].right = l;
+            updateSize(t);
+            lhs = t;
+            rhs = r;
+        } else {
+            split(nodes[t].left, index, inclusive, l, r);
+            nodes[t].left = r;
+            updateSize(t);
+            lhs = l;
+            rhs = t;
+        }
+    }
+
+    TreapIndex transplant(const RecursiveArenaTreap &from, TreapIndex t)
+    {
+        if (t == treapNull) return treapNull;
+        const node &n = from.nodes[t];
+        TreapIndex l = transplant(from, n.left);
+        TreapIndex r = transplant(from, n.right);
+        TreapIndex copy = nodes.create(n.key, n.val, n.priority, l, r);
+        nodes[copy].size = n.size;
+        return copy;
+    }
+
+    void release(TreapIndex t)
+    {
+        if (t == treapNull) return;
+        release(nodes[t].left);
+        release(nodes[t].right);
+        nodes.destroy(t);
+    }
+public:
+    RecursiveArenaTreap() : root(treapNull) {}
+    RecursiveArenaTreap(RecursiveArenaTreap &&other) : nodes(std::move(other.nodes)), root(other.root)
+    {
+        other.nodes.clear();
+        other.root = treapNull;
+    }
+    RecursiveArenaTreap &operator=(RecursiveArenaTreap &&other)
+    {
+        if (this != &other) {
+            nodes = std::move(other.nodes);
+            root = other.root;
+            other.nodes.clear();
+            other.root = treapNull;
+        }
+        return *this;
+    }
+
+    RecursiveArenaTreap &insert(const Key& k, const Value &data, Priority p = Priority())
+    {
+        TreapIndex temp = nodes.create(k, data, p);
+        TreapIndex left_tree, right_tree;
+        split(root, k, /* inclusive */ true, left_tree, right_tree);
+        root = merge(merge(left_tree, temp), right_tree);
+        return *this;
+    }
+
+    RecursiveArenaTreap &remove(const Key& k)
+    {
+        TreapIndex left_tree, right_tree, doomed;
+        split(root, k, /* inclusive */ true, left_tree, right_tree);
+        split(left_tree, k, /* inclusive */ false, left_tree, doomed);
+        release(doomed);
+        root = merge(left_tree, right_tree);
+        return *this;
+    }
+
+    RecursiveArenaTreap &merge(RecursiveArenaTreap &rhs)
+    {
+        if (empty()) {
+            *this = std::move(rhs);
+        } else if (!rhs.empty()) {
+            root = merge(root, transplant(rhs, rhs.root));
+            rhs = RecursiveArenaTreap();
+        }
+        return *this;
+    }
+
+    RecursiveArenaTreap split(const Key& index, bool inclusive = true)
+    {
+        TreapIndex right_tree;
+        split(root, index, inclusive, root, right_tree);
+        RecursiveArenaTreap res;
+        res.root = res.transplant(*this, right_tree);
+        release(right_tree);
+        return res;
+    }
+
+    bool rekey(const Key& from, const Key& to)
+    {
+        TreapIndex *link = &root;
+        while (*link != treapNull) {
+            node &t = nodes[*link];
+            if (t.key == from) break;
+            bool fromLeft = from < t.key;
+            if (fromLeft != (to < t.key)) break;
+            link = fromLeft ? &t.left : &t.right;
+        }
+
+        TreapIndex x = *link;
+        while (x != treapNull && !(nodes[x].key == from)) x = from < nodes[x].key ? nodes[x].left : nodes[x].right;
+        if (x == treapNull) return false;
+
+        TreapIndex *at = link;
+        while (*at != x) {
+            node &t = nodes[*at];
+            t.size--;
+            at = from < t.key ? &t.left : &t.right;
+        }
+        TreapIndex children = merge(nodes[x].left, nodes[x].right);
+        *at = children;
+
+        nodes[x].key = to;
+        at = link;
+        while (*at != treapNull && !(nodes[*at].priority < nodes[x].priority)) {
+            node &t = nodes[*at];
+            t.size++;
+            at = to < t.key ? &t.left : &t.right;
+        }
+        split(*at, to, /* inclusive */ true, nodes[x].left, nodes[x].right);
+        updateSize(x);
+        *at = x;
+        return true;
+    }
+
+    int size() const { return sz(root); }
+    bool empty() const { return root == treapNull; }
+};
+
+}
+
+#endif /* reference_treaps_hpp */
@@ -0,0 +1,159 @@
+// Per-operation costs of the treap's split and merge, as the median tree uses them, next to
+//   the versions they replaced (frozen in reference_treaps.hpp): keys are (degree, vertex)
+//   pairs with degrees from 1 to 20, and a vertex's key moves by one degree at a time.
+//   - remove+insert: take a key out and put it back one degree up or down; now each of the
+//     two splits and merges only the subtree under where the key is (or goes), where the
+//     older versions split and merge the whole tree, recursively
+//   - rekey: the same move done in place, as the median tree does it (the pointer version
+//     never had it)
+//   - split+merge: split off the top 100 keys into a tree of their own and merge them back
+//     (the arena versions copy the nodes between the two trees' arenas, hence the small part)
+//   with a std::multiset erase and insert of the same keys for comparison.
+//
+//   treap_bench [operations [nodes...]]
+//
+// With no arguments, 1,000,000 operations on 10^3, 10^5 and 10^6 nodes.
+
+#include "median_degree.hpp"
+#include "reference_treaps.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+    using DegName = MedianDegreeStruct::DegName;
+    using VertexId = MedianDegreeStruct::VertexId;
+    using Current = MedianDegreeStruct::MedianMap;
+    using Pointers = reference::PointerTreap<DegName,int,Random>;
+    using RecursiveArena = reference::RecursiveArenaTreap<DegName,int,Random>;
+
+    // The same moves for every kind of operation: vertex, and whether it goes up a degree.
+    struct Move {
+        VertexId v;
+        bool up;
+    };
+
+    template <class Fn>
+    double timePerOp(std::size_t operations, Fn fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < operations; i++) fn(i);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+    }
+
+    // every version gets the same keys with the same priorities, and so the same shape
+    template <class Tree>
+    void build(Tree &tree, const std::vector<int> &degrees)
+    {
+        std::srand(1);
+        for (VertexId v = 0; v < degrees.size(); v++) tree.insert(DegName(degrees[v], v), 0);
+    }
+
+    // a degree one up or down, but not below one
+    int moved(int d, bool up) { return d == 1 || up ? d + 1 : d - 1; }
+
+    template <class Tree>
+    double removeInsert(std::vector<int> degrees, const std::vector<Move> &moves)
+    {
+        Tree tree;
+        build(tree, degrees);
+        double t = timePerOp(moves.size(), [&](std::size_t i) {
+            VertexId v = moves[i].v;
+            int to = moved(degrees[v], moves[i].up);
+            tree.remove(DegName(degrees[v], v));
+            tree.insert(DegName(to, v), 0);
+            degrees[v] = to;
+        });
+        return tree.size() == static_cast<int>(degrees.size()) ? t : -1;
+    }
+
+    template <class Tree>
+    double rekey(std::vector<int> degrees, const std::vector<Move> &moves)
+    {
+        Tree tree;
+        build(tree, degrees);
+        double t = timePerOp(moves.size(), [&](std::size_t i) {
+            VertexId v = moves[i].v;
+            int to = moved(degrees[v], moves[i].up);
+            tree.rekey(DegName(degrees[v], v), DegName(to, v));
+            degrees[v] = to;
+        });
+        return tree.size() == static_cast<int>(degrees.size()) ? t : -1;
+    }
+
+    // the key to split at is the 100th from the top, which the round trips leave alone
+    template <class Tree>
+    double splitMerge(const std::vector<int> &degrees, DegName at, std::size_t operations)
+    {
+        Tree tree;
+        build(tree, degrees);
+        double t = timePerOp(operations, [&](std::size_t) {
+            Tree top = tree.split(at, false);
+            tree.merge(top);
+        });
+        return tree.size() == static_cast<int>(degrees.size()) ? t : -1;
+    }
+
+    double multiset(std::vector<int> degrees, const std::vector<Move> &moves)
+    {
+        std::multiset<DegName> set;
+        for (VertexId v = 0; v < degrees.size(); v++) set.insert(DegName(degrees[v], v));
+        return timePerOp(moves.size(), [&](std::size_t i) {
+            VertexId v = moves[i].v;
+            int to = moved(degrees[v], moves[i].up);
+            set.erase(set.find(DegName(degrees[v], v)));
+            set.insert(DegName(to, v));
+            degrees[v] = to;
+        });
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    long operations = argc > 1 ? std::atol(argv[1]) : 1000000;
+    std::vector<long> sizes;
+    for (int i = 2; i < argc; i++) sizes.push_back(std::atol(argv[i]));
+    if (sizes.empty()) sizes = {1000, 100000, 1000000};
+    if (operations <= 0 || std::find_if(sizes.begin(), sizes.end(), [](long n) { return n <= 100; }) != sizes.end()) {
+        std::fprintf(stderr, "usage: %s [operations [nodes (over 100)...]]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-10s %-14s %12s %18s %10s %10s\n", "nodes", "operation", "unique_ptr", "arena, recursive", "this", "multiset");
+    for (long n : sizes) {
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<int> degree(1, 20);
+        std::vector<int> degrees(n);
+        for (int &d : degrees) d = degree(rng);
+        std::uniform_int_distribution<VertexId> pick(0, static_cast<VertexId>(n - 1));
+        std::vector<Move> moves(operations);
+        for (Move &m : moves) m = Move{pick(rng), (rng() & 1) != 0};
+
+        std::vector<DegName> sorted;
+        for (VertexId v = 0; v < degrees.size(); v++) sorted.push_back(DegName(degrees[v], v));
+        std::sort(sorted.begin(), sorted.end());
+        DegName at = sorted[sorted.size() - 100];
+
+        double times[] = {
+            removeInsert<Pointers>(degrees, moves), removeInsert<RecursiveArena>(degrees, moves),
+            removeInsert<Current>(degrees, moves), multiset(degrees, moves),
+            rekey<RecursiveArena>(degrees, moves), rekey<Current>(degrees, moves),
+            splitMerge<Pointers>(degrees, at, moves.size()), splitMerge<RecursiveArena>(degrees, at, moves.size()),
+            splitMerge<Current>(degrees, at, moves.size()),
+        };
+        if (std::find(std::begin(times), std::end(times), -1.0) != std::end(times)) {
+            std::fprintf(stderr, "lost keys along the way\n");
+            return 1;
+        }
+        std::printf("%-10ld %-14s %9.0f ns %15.0f ns %7.0f ns %7.0f ns\n", n, "remove+insert", times[0], times[1], times[2], times[3]);
+        std::printf("%-10ld %-14s %12s %15.0f ns %7.0f ns\n", n, "rekey", "-", times[4], times[5]);
+        std::printf("%-10ld %-14s %9.0f ns %15.0f ns %7.0f ns\n", n, "split+merge", times[6], times[7], times[8]);
+    }
+    return 0;
+}
@@ -78,8 +78,14 @@ function run_all_tests {
 
     setup_testing_input_output
 
+    # the command-line options the test is run with, if it has any
+    RUN_OPTIONS=""
+    if [ -f ${GRADER_ROOT}/tests/${test_folder}/options ]; then
+      RUN_OPTIONS=$(cat ${GRADER_ROOT}/tests/${test_folder}/options)
+    fi
+
     cd ${GRADER_ROOT}/temp
-    bash run.sh 2>&1
+    RUN_OPTIONS="${RUN_OPTIONS}" bash run.sh 2>&1
     cd ../
 
     compare_outputs
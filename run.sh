@@ -6,7 +6,8 @@
 # I'll execute my programs, with the input directory venmo_input and output the files in the directory venmo_output
 cd src/
 make
-../bin/rolling_median ../venmo_input/venmo-trans.txt ../venmo_output/output.txt
+# (with whatever options are in RUN_OPTIONS, as the test suite sets for some tests)
+../bin/rolling_median ${RUN_OPTIONS} ../venmo_input/venmo-trans.txt ../venmo_output/output.txt
 
 
 
@@ -0,0 +1,452 @@
+#ifndef counted_btree_hpp
+#define counted_btree_hpp
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Order-statistics tree as a B+tree: the keys sit sorted in leaves a few cache lines wide,
+//   and each inner node keeps, next to every child, the number of keys below it. Finding a
+//   key or a rank scans one small array per level instead of chasing a pointer per binary
+//   decision, so a tree of millions of keys is only four or five levels of a few cache lines
+//   each. It has the same insert/remove/orderStatistic interface as Treap, so either can be
+//   the median tree.
+// Keys must be distinct (as they are in the median tree). Nodes are kept in arenas and
+//   linked by 32-bit indices, with free slots recycled, like the treap's.
+template <class Key, class Value>
+class CountedBTree {
+public:
+    CountedBTree() : root(newLeaf()), height(0), total(0) {}
+
+    CountedBTree<Key, Value> &insert(const Key &k, const Value &v);
+    CountedBTree<Key, Value> &remove(const Key &k)
+    { Value unused; if (removeAt(root, height, k, unused)) { total--; shrink(); } return *this; }
+    // change a key, keeping its value; returns false if there's no such key
+    bool rekey(const Key &from, const Key &to);
+    // the same for each (from, to) pair of a range, in turn
+    template <class Iter>
+    void rekey(Iter first, Iter last) { for ( ; first != last; ++first) rekey(first->first, first->second); }
+    // remove every key in a range of keys
+    template <class Iter>
+    CountedBTree<Key, Value> &removeSorted(Iter first, Iter last) { for ( ; first != last; ++first) remove(*first); return *this; }
+
+    // the key and value of the given rank, counting from zero
+    std::pair<Key, Value> orderStatistic(int index) const;
+    // the keys of several ranks (sorted, and each less than size()), appended to keys, in
+    //   one walk down the tree
+    void select(const std::vector<int> &ranks, std::vector<Key> &keys) const
+    { if (!ranks.empty()) selectAll(root, height, 0, ranks.data(), ranks.data() + ranks.size(), keys); }
+
+    // how many keys are less than k
+    int rank(const Key &k) const;
+
+    int size() const { return total; }
+    bool empty() const { return total == 0; }
+private:
+    using Index = std::uint32_t;
+
+    // Nodes are sized to a few cache lines: a leaf has a count and the keys and values, an
+    //   inner node a count, and for each child the smallest key it may hold (the first one's
+    //   is unused), its index and how many keys are below it.
+    static const int nodeBytes = 4 * 64;
+    static const int leafCap = (nodeBytes - sizeof(int)) / (sizeof(Key) + sizeof(Value));
+    static const int innerCap = (nodeBytes - sizeof(int)) / (sizeof(Key) + sizeof(Index) + sizeof(int));
+    static_assert(leafCap >= 4 && innerCap >= 4, "keys too big for the node size");
+
+    struct Leaf {
+        int n = 0;
+        Key keys[leafCap];
+        Value vals[leafCap];
+    };
+    struct Inner {
+        int n = 0;
+        Key low[innerCap];     // low[i] <= every key under child i, for i > 0
+        Index kids[innerCap];
+        int counts[innerCap];  // keys under each child
+    };
+
+    // arenas; references into them are only good until the next newLeaf()/newInner()
+    Index newLeaf();
+    Index newInner();
+    void freeLeaf(Index i) { freeLeaves.push_back(i); }
+    void freeInner(Index i) { freeInners.push_back(i); }
+
+    // which child of an inner node a key belongs under
+    static int childFor(const Inner &in, const Key &k)
+    {
+        int i = 1;
+        while (i < in.n && !(k < in.low[i])) i++;
+        return i - 1;
+    }
+    int fill(Index node, int level) const { return level == 0 ? leaves[node].n : inners[node].n; }
+    int capacity(int level) const { return level == 0 ? leafCap : innerCap; }
+
+    // insert under node, at the given level (0 for a leaf); if the node had to split, returns
+    //   true, with its new right sibling, the sibling's smallest key and its count
+    bool insertAt(Index node, int level, const Key &k, const Value &v, Key &sepOut, Index &rightOut, int &countOut);
+    // remove k from under node; returns false if it isn't there
+    bool removeAt(Index node, int level, const Key &k, Value &removed);
+    // child i of an inner node has fallen below half full: borrow from a sibling, or merge with it
+    void rebalance(Index parent, int i, int childLevel);
+    // a root with one child hands over to it
+    void shrink();
+    // the keys of the ranks in [first, last) under node, whose keys have ranks from offset on
+    void selectAll(Index node, int level, int offset, const int *first, const int *last, std::vector<Key> &keys) const;
+
+    std::vector<Leaf> leaves;
+    std::vector<Inner> inners;
+    std::vector<Index> freeLeaves, freeInners;
+    Index root;
+    int height; // levels of inner nodes above the leaves
+    int total;
+};
+
+// IMPLEMENTATIONS
+
+template <class Key, class Value>
+typename CountedBTree<Key, Value>::Index CountedBTree<Key, Value>::newLeaf()
+{
+    if (!freeLeaves.empty()) {
+        Index i = freeLeaves.back();
+        freeLeaves.pop_back();
+        leaves[i].n = 0;
+        return i;
+    }
+    leaves.emplace_back();
+    return static_cast<Index>(leaves.size() - 1);
+}
+
+template <class Key, class Value>
+typename CountedBTree<Key, Value>::Index CountedBTree<Key, Value>::newInner()
+{
+    if (!freeInners.empty()) {
+        Index i = freeInners.back();
+        freeInners.pop_back();
+        inners[i].n = 0;
+        return i;
+    }
+    inners.emplace_back();
+    return static_cast<Index>(inners.size() - 1);
+}
+
+template <class Key, class Value>
+CountedBTree<Key, Value> &CountedBTree<Key, Value>::insert(const Key &k, const Value &v)
+{
+    Key sep;
+    Index right;
+    int rightCount;
+    if (insertAt(root, height, k, v, sep, right, rightCount)) {
+        // the root split: grow a new one above the two halves
+        Index r = newInner();
+        Inner &in = inners[r];
+        in.n = 2;
+        in.kids[0] = root;
+        in.counts[0] = total + 1 - rightCount;
+        in.low[1] = sep;
+        in.kids[1] = right;
+        in.counts[1] = rightCount;
+        root = r;
+        height++;
+    }
+    total++;
+    return *this;
+}
+
+template <class Key, class Value>
+bool CountedBTree<Key, Value>::insertAt(Index node, int level, const Key &k, const Value &v, Key &sepOut, Index &rightOut, int &countOut)
+{
+    if (level == 0) {
+        int pos = 0;
+        while (pos < leaves[node].n && !(k < leaves[node].keys[pos])) pos++;
+
+        bool split = leaves[node].n == leafCap;
+        Index target = node;
+        if (split) {
+            // the upper half goes to a new leaf
+            Index r = newLeaf();
+            Leaf &leaf = leaves[node], &right = leaves[r];
+            int keep = leafCap / 2;
+            for (int j = keep; j < leafCap; j++) {
+                right.keys[j - keep] = leaf.keys[j];
+                right.vals[j - keep] = leaf.vals[j];
+            }
+            right.n = leafCap - keep;
+            leaf.n = keep;
+            if (pos > keep) {
+                target = r;
+                pos -= keep;
+            }
+            rightOut = r;
+        }
+
+        Leaf &leaf = leaves[target];
+        for (int j = leaf.n; j > pos; j--) {
+            leaf.keys[j] = leaf.keys[j - 1];
+            leaf.vals[j] = leaf.vals[j - 1];
+        }
+        leaf.keys[pos] = k;
+        leaf.vals[pos] = v;
+        leaf.n++;
+
+        if (split) {
+            sepOut = leaves[rightOut].keys[0];
+            countOut = leaves[rightOut].n;
+        }
+        return split;
+    }
+
+    int i = childFor(inners[node], k);
+    inners[node].counts[i]++;
+    Key sep;
+    Index child;
+    int childCount;
+    if (!insertAt(inners[node].kids[i], level - 1, k, v, sep, child, childCount)) return false;
+
+    // child i split in two; its new right half goes in after it
+    bool split = inners[node].n == innerCap;
+    Index target = node;
+    int pos = i + 1;
+    if (split) {
+        Index r = newInner();
+        Inner &in = inners[node], &right = inners[r];
+        int keep = innerCap / 2;
+        for (int j = keep; j < innerCap; j++) {
+            right.low[j - keep] = in.low[j];
+            right.kids[j - keep] = in.kids[j];
+            right.counts[j - keep] = in.counts[j];
+        }
+        right.n = innerCap - keep;
+        in.n = keep;
+        if (pos > keep) {
+            target = r;
+            pos -= keep;
+        }
+        rightOut = r;
+    }
+
+    Inner &in = inners[target];
+    // the count that went to child i (just before pos, either way) includes its right half's
+    in.counts[pos - 1] -= childCount;
+    for (int j = in.n; j > pos; j--) {
+        in.low[j] = in.low[j - 1];
+        in.kids[j] = in.kids[j - 1];
+        in.counts[j] = in.counts[j - 1];
+    }
+    in.low[pos] = sep;
+    in.kids[pos] = child;
+    in.counts[pos] = childCount;
+    in.n++;
+
+    if (split) {
+        const Inner &right = inners[rightOut];
+        sepOut = right.low[0];
+        countOut = 0;
+        for (int j = 0; j < right.n; j++) countOut += right.counts[j];
+    }
+    return split;
+}
+
+template <class Key, class Value>
+bool CountedBTree<Key, Value>::removeAt(Index node, int level, const Key &k, Value &removed)
+{
+    if (level == 0) {
+        Leaf &leaf = leaves[node];
+        int pos = 0;
+        while (pos < leaf.n && leaf.keys[pos] < k) pos++;
+        if (pos == leaf.n || k < leaf.keys[pos]) return false;
+        removed = leaf.vals[pos];
+        for (int j = pos + 1; j < leaf.n; j++) {
+            leaf.keys[j - 1] = leaf.keys[j];
+            leaf.vals[j - 1] = leaf.vals[j];
+        }
+        leaf.n--;
+        return true;
+    }
+
+    int i = childFor(inners[node], k);
+    if (!removeAt(inners[node].kids[i], level - 1, k, removed)) return false;
+    inners[node].counts[i]--;
+    if (fill(inners[node].kids[i], level - 1) < capacity(level - 1) / 2) rebalance(node, i, level - 1);
+    return true;
+}
+
+template <class Key, class Value>
+void CountedBTree<Key, Value>::rebalance(Index parent, int i, int childLevel)
+{
+    Inner &p = inners[parent];
+    if (p.n < 2) return; // only the root can be like this, and shrink() deals with it
+    // work on child i and a neighbour, as the pair (a, b = a + 1)
+    int a = i + 1 < p.n ? i : i - 1, b = a + 1;
+    Index an = p.kids[a], bn = p.kids[b];
+    int half = capacity(childLevel) / 2;
+
+    if (childLevel == 0) {
+        Leaf &la = leaves[an], &lb = leaves[bn];
+        if (la.n + lb.n < 2 * half) {
+            // merge b into a
+            for (int j = 0; j < lb.n; j++) {
+                la.keys[la.n + j] = lb.keys[j];
+                la.vals[la.n + j] = lb.vals[j];
+            }
+            la.n += lb.n;
+            freeLeaf(bn);
+        } else if (la.n < lb.n) {
+            // a borrows b's first key
+            la.keys[la.n] = lb.keys[0];
+            la.vals[la.n] = lb.vals[0];
+            la.n++;
+            for (int j = 1; j < lb.n; j++) {
+                lb.keys[j - 1] = lb.keys[j];
+                lb.vals[j - 1] = lb.vals[j];
+            }
+            lb.n--;
+            p.low[b] = lb.keys[0];
+            p.counts[a]++;
+            p.counts[b]--;
+            return;
+        } else {
+            // b borrows a's last key
+            for (int j = lb.n; j > 0; j--) {
+                lb.keys[j] = lb.keys[j - 1];
+                lb.vals[j] = lb.vals[j - 1];
+            }
+            la.n--;
+            lb.keys[0] = la.keys[la.n];
+            lb.vals[0] = la.vals[la.n];
+            lb.n++;
+            p.low[b] = lb.keys[0];
+            p.counts[a]--;
+            p.counts[b]++;
+            return;
+        }
+    } else {
+        Inner &ia = inners[an], &ib = inners[bn];
+        if (ia.n + ib.n < 2 * half) {
+            // merge b into a; b's first child is bounded by b's own bound in the parent
+            for (int j = 0; j < ib.n; j++) {
+                ia.low[ia.n + j] = j == 0 ? p.low[b] : ib.low[j];
+                ia.kids[ia.n + j] = ib.kids[j];
+                ia.counts[ia.n + j] = ib.counts[j];
+            }
+            ia.n += ib.n;
+            freeInner(bn);
+        } else if (ia.n < ib.n) {
+            // a takes b's first child
+            int moved = ib.counts[0];
+            ia.low[ia.n] = p.low[b];
+            ia.kids[ia.n] = ib.kids[0];
+            ia.counts[ia.n] = moved;
+            ia.n++;
+            p.low[b] = ib.low[1];
+            for (int j = 1; j < ib.n; j++) {
+                ib.low[j - 1] = ib.low[j];
+                ib.kids[j - 1] = ib.kids[j];
+                ib.counts[j - 1] = ib.counts[j];
+            }
+            ib.n--;
+            p.counts[a] += moved;
+            p.counts[b] -= moved;
+            return;
+        } else {
+            // b takes a's last child
+            for (int j = ib.n; j > 0; j--) {
+                ib.low[j] = ib.low[j - 1];
+                ib.kids[j] = ib.kids[j - 1];
+                ib.counts[j] = ib.counts[j - 1];
+            }
+            ia.n--;
+            int moved = ia.counts[ia.n];
+            ib.low[1] = p.low[b];
+            ib.kids[0] = ia.kids[ia.n];
+            ib.counts[0] = moved;
+            ib.n++;
+            p.low[b] = ia.low[ia.n];
+            p.counts[a] -= moved;
+            p.counts[b] += moved;
+            return;
+        }
+    }
+
+    // b is gone: close the gap in the parent
+    p.counts[a] += p.counts[b];
+    for (int j = b + 1; j < p.n; j++) {
+        p.low[j - 1] = p.low[j];
+        p.kids[j - 1] = p.kids[j];
+        p.counts[j - 1] = p.counts[j];
+    }
+    p.n--;
+}
+
+template <class Key, class Value>
+void CountedBTree<Key, Value>::shrink()
+{
+    while (height > 0 && inners[root].n == 1) {
+        Index old = root;
+        root = inners[old].kids[0];
+        freeInner(old);
+        height--;
+    }
+}
+
+template <class Key, class Value>
+bool CountedBTree<Key, Value>::rekey(const Key &from, const Key &to)
+{
+    Value v;
+    if (!removeAt(root, height, from, v)) return false;
+    shrink();
+    total--;
+    insert(to, v);
+    return true;
+}
+
+template <class Key, class Value>
+void CountedBTree<Key, Value>::selectAll(Index node, int level, int offset, const int *first, const int *last, std::vector<Key> &keys) const
+{
+    if (level == 0) {
+        for ( ; first != last; ++first) keys.push_back(leaves[node].keys[*first - offset]);
+        return;
+    }
+    // hand each child the ranks that fall under it
+    const Inner &in = inners[node];
+    for (int i = 0; i < in.n && first != last; i++) {
+        int end = offset + in.counts[i];
+        const int *mid = first;
+        while (mid != last && *mid < end) mid++;
+        if (mid != first) selectAll(in.kids[i], level - 1, offset, first, mid, keys);
+        first = mid;
+        offset = end;
+    }
+}
+
+template <class Key, class Value>
+std::pair<Key, Value> CountedBTree<Key, Value>::orderStatistic(int index) const
+{
+    Index node = root;
+    for (int level = height; level > 0; level--) {
+        const Inner &in = inners[node];
+        int i = 0;
+        while (index >= in.counts[i]) index -= in.counts[i++];
+        node = in.kids[i];
+    }
+    return std::make_pair(leaves[node].keys[index], leaves[node].vals[index]);
+}
+
+template <class Key, class Value>
+int CountedBTree<Key, Value>::rank(const Key &k) const
+{
+    Index node = root;
+    int before = 0;
+    for (int level = height; level > 0; level--) {
+        const Inner &in = inners[node];
+        int c = childFor(in, k);
+        for (int i = 0; i < c; i++) before += in.counts[i];
+        node = in.kids[c];
+    }
+    const Leaf &leaf = leaves[node];
+    int i = 0;
+    while (i < leaf.n && leaf.keys[i] < k) i++;
+    return before + i;
+}
+
+#endif /* counted_btree_hpp */
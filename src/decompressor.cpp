@@ -0,0 +1,111 @@
+#include "decompressor.hpp"
+#include <climits>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+#ifdef HAVE_ZLIB
+    class GzipDecompressor : public Decompressor {
+    public:
+        GzipDecompressor() : ok(true), streamEnded(false)
+        {
+            std::memset(&zs, 0, sizeof zs);
+            ok = inflateInit2(&zs, 15 + 16) == Z_OK; // 16: expect a gzip header
+        }
+        ~GzipDecompressor() { inflateEnd(&zs); }
+
+        std::size_t run(const char *&in, const char *inEnd, char *out, std::size_t outSize) override
+        {
+            if (!ok || in == inEnd) return 0;
+            if (streamEnded) { // another member follows
+                inflateReset(&zs);
+                streamEnded = false;
+            }
+            // zlib counts in unsigned ints; whatever doesn't fit is left for the next call
+            std::size_t inSize = inEnd - in;
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+            zs.avail_in = inSize < UINT_MAX ? unsigned(inSize) : UINT_MAX;
+            zs.next_out = reinterpret_cast<Bytef*>(out);
+            zs.avail_out = outSize < UINT_MAX ? unsigned(outSize) : UINT_MAX;
+
+            int r = inflate(&zs, Z_NO_FLUSH);
+            in = reinterpret_cast<const char*>(zs.next_in);
+            if (r == Z_STREAM_END) streamEnded = true;
+            else if (r != Z_OK && r != Z_BUF_ERROR) ok = false;
+            return reinterpret_cast<char*>(zs.next_out) - out;
+        }
+
+        bool failed() const override { return !ok; }
+        bool atStreamEnd() const override { return streamEnded; }
+    private:
+        z_stream zs;
+        bool ok, streamEnded;
+    };
+#endif
+
+#ifdef HAVE_ZSTD
+    class ZstdDecompressor : public Decompressor {
+    public:
+        ZstdDecompressor() : ds(ZSTD_createDStream()), ok(false), frameEnded(false)
+        {
+            ok = ds && !ZSTD_isError(ZSTD_initDStream(ds));
+        }
+        ~ZstdDecompressor() { ZSTD_freeDStream(ds); }
+
+        std::size_t run(const char *&in, const char *inEnd, char *out, std::size_t outSize) override
+        {
+            if (!ok || in == inEnd) return 0;
+            // zstd moves on to the next frame by itself
+            ZSTD_inBuffer ib = { in, std::size_t(inEnd - in), 0 };
+            ZSTD_outBuffer ob = { out, outSize, 0 };
+            std::size_t r = ZSTD_decompressStream(ds, &ob, &ib);
+            in += ib.pos;
+            if (ZSTD_isError(r)) ok = false;
+            else frameEnded = r == 0;
+            return ob.pos;
+        }
+
+        bool failed() const override { return !ok; }
+        bool atStreamEnd() const override { return frameEnded; }
+    private:
+        ZSTD_DStream *ds;
+        bool ok, frameEnded;
+    };
+#endif
+}
+
+Decompressor::Format Decompressor::detect(const char *p, std::size_t n)
+{
+    const unsigned char *u = reinterpret_cast<const unsigned char*>(p);
+    if (n >= 2 && u[0] == 0x1F && u[1] == 0x8B) return Gzip;
+    if (n >= 4 && u[0] == 0x28 && u[1] == 0xB5 && u[2] == 0x2F && u[3] == 0xFD) return Zstd;
+    return Uncompressed; // a Venmo record starts with '{' (or whitespace)
+}
+
+std::unique_ptr<Decompressor> Decompressor::create(Format f)
+{
+    switch (f) {
+#ifdef HAVE_ZLIB
+        case Gzip: return std::unique_ptr<Decompressor>(new GzipDecompressor());
+#endif
+#ifdef HAVE_ZSTD
+        case Zstd: return std::unique_ptr<Decompressor>(new ZstdDecompressor());
+#endif
+        default: return nullptr;
+    }
+}
+
+const char *Decompressor::formatName(Format f)
+{
+    switch (f) {
+        case Gzip: return "gzip";
+        case Zstd: return "zstd";
+        default: return "uncompressed";
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef decompressor_hpp
+#define decompressor_hpp
+
+#include <cstddef>
+#include <memory>
+
+// Streaming decompression, so that archived (compressed) transaction logs can be read
+//   as they are, without unpacking them to disk first. The input is handed over in
+//   whatever pieces it arrives in, and comes out in whatever pieces fit.
+//   Which formats are available depends on the libraries found at build time
+//   (HAVE_ZLIB for gzip, HAVE_ZSTD for zstd).
+class Decompressor {
+public:
+    enum Format { Uncompressed, Gzip, Zstd };
+
+    // tell the format from the first few bytes of the input (four are enough)
+    static Format detect(const char *p, std::size_t n);
+    // null if this build can't decompress the format
+    static std::unique_ptr<Decompressor> create(Format f);
+    static const char *formatName(Format f);
+
+    virtual ~Decompressor() {}
+
+    // Decompress as much of [in, inEnd) as fits into out (outSize bytes); in is advanced
+    //   past whatever was consumed. Returns the number of bytes produced.
+    //   Concatenated streams (as from pigz, or cat) are read one after the other.
+    virtual std::size_t run(const char *&in, const char *inEnd, char *out, std::size_t outSize) = 0;
+
+    // the input is corrupt; everything produced before that is still good
+    virtual bool failed() const = 0;
+    // the last stream was complete (if the input ends now, it wasn't truncated)
+    virtual bool atStreamEnd() const = 0;
+};
+
+#endif /* decompressor_hpp */
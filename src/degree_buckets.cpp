@@ -0,0 +1,109 @@
+#include "degree_buckets.hpp"
+#include <algorithm>
+#include <cassert>
+
+void DegreeBuckets::change(VertexId v, int oldDeg, int newDeg)
+{
+    assert(newDeg == oldDeg + 1 || newDeg == oldDeg - 1);
+    if (newDeg > 0) {
+        if (levels.size() <= static_cast<std::size_t>(newDeg)) {
+            levels.resize(newDeg + 1);
+            higher.resize(newDeg + 1, 0);
+            lower.resize(newDeg + 1, 0);
+        }
+        if (levels[newDeg].empty()) {
+            // the first one here: it goes next to where the vertex comes from, which is still
+            //   in the list (degree 0 always is)
+            int below = newDeg > oldDeg ? oldDeg : lower[oldDeg];
+            int above = higher[below];
+            lower[newDeg] = below;
+            higher[newDeg] = above;
+            higher[below] = newDeg;
+            lower[above] = newDeg;
+        }
+    }
+    if (oldDeg > 0) {
+        unlink(v, oldDeg);
+        if (levels[oldDeg].empty()) {
+            higher[lower[oldDeg]] = higher[oldDeg];
+            lower[higher[oldDeg]] = lower[oldDeg];
+        }
+    }
+    if (newDeg > 0) link(v, newDeg);
+}
+
+void DegreeBuckets::link(VertexId v, int deg)
+{
+    if (slot.size() <= v) slot.resize(v + 1);
+    std::vector<VertexId> &heap = levels[deg];
+    heap.push_back(v);
+    place(heap, heap.size() - 1, v);
+    siftUp(heap, heap.size() - 1);
+}
+
+void DegreeBuckets::unlink(VertexId v, int deg)
+{
+    // the last one takes its place
+    std::vector<VertexId> &heap = levels[deg];
+    std::size_t i = slot[v];
+    VertexId last = heap.back();
+    heap.pop_back();
+    if (i == heap.size()) return;
+    place(heap, i, last);
+    siftUp(heap, i);
+    siftDown(heap, slot[last]);
+}
+
+void DegreeBuckets::siftUp(std::vector<VertexId> &heap, std::size_t i)
+{
+    VertexId v = heap[i];
+    while (i > 0 && v < heap[(i - 1) / 2]) {
+        place(heap, i, heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    place(heap, i, v);
+}
+
+void DegreeBuckets::siftDown(std::vector<VertexId> &heap, std::size_t i)
+{
+    VertexId v = heap[i];
+    while (true) {
+        std::size_t c = 2 * i + 1;
+        if (c >= heap.size()) break;
+        if (c + 1 < heap.size() && heap[c + 1] < heap[c]) c++;
+        if (!(heap[c] < v)) break;
+        place(heap, i, heap[c]);
+        i = c;
+    }
+    place(heap, i, v);
+}
+
+void DegreeBuckets::top(std::size_t k, std::vector<std::pair<int,VertexId>> &out) const
+{
+    out.clear();
+    for (int d = lower[0]; d != 0 && out.size() < k; d = lower[d]) {
+        const std::vector<VertexId> &heap = levels[d];
+        std::size_t room = k - out.size(), start = out.size();
+        if (heap.size() <= room) {
+            // everyone of this degree makes it
+            for (VertexId v : heap) out.push_back(std::make_pair(d, v));
+            std::sort(out.begin() + start, out.end());
+            continue;
+        }
+        // Only the lowest ids of this degree make it: take them off the heap in order,
+        //   keeping a frontier of the positions whose parents have been taken (as a heap of
+        //   its own, by the id at each position)
+        auto later = [&heap](std::uint32_t a, std::uint32_t b) { return heap[a] > heap[b]; };
+        frontier.assign(1, 0);
+        while (room-- > 0) {
+            std::pop_heap(frontier.begin(), frontier.end(), later);
+            std::uint32_t i = frontier.back();
+            frontier.pop_back();
+            out.push_back(std::make_pair(d, heap[i]));
+            for (std::uint32_t c = 2 * i + 1; c <= 2 * i + 2 && c < heap.size(); c++) {
+                frontier.push_back(c);
+                std::push_heap(frontier.begin(), frontier.end(), later);
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef degree_buckets_hpp
+#define degree_buckets_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// The vertices themselves, grouped by degree, for when the histogram is in use and someone
+//   wants to know who has the highest degrees (the trees have that at their top end already).
+//   Each degree keeps its vertices as a min-heap on the vertex id, with every vertex's place
+//   in its heap kept by id, so that moving a vertex is O(log) of its degree's population.
+//   The degrees that have anyone are linked in a circular list through degree 0, and since
+//   degrees only ever move by one, a degree that fills up goes right next to the one the
+//   vertex came from. The k highest are then read off from the top in O(k log k), without
+//   looking at empty degrees or at anyone who doesn't make it.
+class DegreeBuckets {
+public:
+    using VertexId = std::uint32_t;
+
+    DegreeBuckets() : levels(1), higher(1, 0), lower(1, 0) {}
+
+    // vertex v goes from degree oldDeg to newDeg (zero meaning it isn't in the graph); the
+    //   two are one apart
+    void change(VertexId v, int oldDeg, int newDeg);
+
+    // The k highest degrees, highest first, as (degree, vertex) pairs; among vertices of
+    //   the same degree, the lower id comes first. Fewer if there aren't k vertices.
+    void top(std::size_t k, std::vector<std::pair<int,VertexId>> &out) const;
+private:
+    void link(VertexId v, int deg);
+    void unlink(VertexId v, int deg);
+    // restore the heap order of a degree's vertices around position i
+    void siftUp(std::vector<VertexId> &heap, std::size_t i);
+    void siftDown(std::vector<VertexId> &heap, std::size_t i);
+    void place(std::vector<VertexId> &heap, std::size_t i, VertexId v) { heap[i] = v; slot[v] = static_cast<std::uint32_t>(i); }
+
+    std::vector<std::vector<VertexId>> levels; // levels[d]: the vertices of degree d, as a heap
+    std::vector<std::uint32_t> slot;           // where each vertex is in its heap, by vertex id
+    std::vector<int> higher, lower;            // the next degree up and down that has anyone
+    mutable std::vector<std::uint32_t> frontier; // scratch space for top()
+};
+
+#endif /* degree_buckets_hpp */
@@ -0,0 +1,64 @@
+#include "degree_histogram.hpp"
+
+void DegreeHistogram::add(int deg, int delta)
+{
+    if (deg <= 0) return; // degree zero is not in the graph
+    if (deg >= static_cast<int>(counts.size())) counts.resize(2 * deg, 0);
+    counts[deg] += delta;
+    total += delta;
+    if (deg < cursor) below += delta;
+}
+
+void DegreeHistogram::change(int oldDeg, int newDeg)
+{
+    add(oldDeg, -1);
+    add(newDeg, +1);
+    seek();
+}
+
+void DegreeHistogram::seek()
+{
+    if (total == 0) {
+        cursor = 1;
+        below = 0;
+        return;
+    }
+    const std::int64_t rank = (total - 1) / 2; // zero-based
+    while (below > rank) below -= counts[--cursor];
+    while (below + counts[cursor] <= rank) below += counts[cursor++];
+}
+
+void DegreeHistogram::select(const std::vector<int> &ranks, std::vector<int> &degrees) const
+{
+    degrees.resize(ranks.size());
+    std::size_t split = 0; // ranks[split] is the first one at or past the cursor's bucket
+    while (split < ranks.size() && ranks[split] < below) split++;
+
+    // walk up for those...
+    int d = cursor;
+    std::int64_t before = below; // vertices of degree less than d
+    for (std::size_t i = split; i < ranks.size(); i++) {
+        while (before + counts[d] <= ranks[i]) before += counts[d++];
+        degrees[i] = d;
+    }
+    // ...and down for the rest
+    d = cursor;
+    before = below;
+    for (std::size_t i = split; i-- > 0; ) {
+        while (before > ranks[i]) before -= counts[--d];
+        degrees[i] = d;
+    }
+}
+
+double DegreeHistogram::median() const
+{
+    if (total == 0) return 0.0/0.0; // NaN
+    if (total % 2) return cursor;
+
+    // even size: the upper median is either in the same bucket or the next nonempty one up
+    const std::int64_t upper = total / 2;
+    int hi = cursor;
+    std::int64_t upTo = below + counts[hi];
+    while (upTo <= upper) upTo += counts[++hi];
+    return 0.5 * (cursor + hi);
+}
@@ -0,0 +1,36 @@
+#ifndef degree_histogram_hpp
+#define degree_histogram_hpp
+
+#include <cstdint>
+#include <vector>
+
+// Median of the vertex degrees, kept as a histogram: how many vertices there are of each
+//   degree. A payment only ever moves a vertex's degree up or down by one, so instead of
+//   re-sorting anything, a cursor is kept on the bucket that holds the (lower) median,
+//   together with the number of vertices below it; after each change the cursor moves
+//   by a bucket or so, which makes both updates and queries O(1) in practice.
+//   Unlike the treap, this doesn't care which vertex is which, only how many.
+class DegreeHistogram {
+public:
+    DegreeHistogram() : counts(2, 0), total(0), cursor(1), below(0) {}
+
+    // one vertex goes from degree oldDeg to newDeg (zero meaning it isn't in the graph)
+    void change(int oldDeg, int newDeg);
+
+    int size() const { return total; }
+    double median() const; // NaN when empty
+    // the degrees at several ranks (counting from zero, in order of degree; sorted, and each
+    //   less than size()), found in one walk out from the median's bucket
+    void select(const std::vector<int> &ranks, std::vector<int> &degrees) const;
+private:
+    void add(int deg, int delta);
+    // move the cursor to the bucket holding rank (total-1)/2
+    void seek();
+
+    std::vector<int> counts; // counts[d] is the number of vertices of degree d; counts[0] is unused
+    int total;               // vertices of nonzero degree
+    int cursor;              // bucket of the lower median
+    std::int64_t below;      // vertices of degree less than cursor
+};
+
+#endif /* degree_histogram_hpp */
@@ -0,0 +1,63 @@
+#include "flat_edge_map.hpp"
+
+namespace {
+    const unsigned initialLog2 = 10;
+}
+
+FlatEdgeMap::FlatEdgeMap()
+: slots(std::size_t(1) << initialLog2, Slot{emptyKey, 0}), mask(slots.size() - 1), shift(64 - initialLog2), count(0)
+{}
+
+time_t *FlatEdgeMap::find(Key key)
+{
+    for (std::size_t i = home(key); ; i = (i + 1) & mask) {
+        if (slots[i].key == key) return &slots[i].time;
+        if (slots[i].key == emptyKey) return nullptr;
+    }
+}
+
+void FlatEdgeMap::insert(Key key, time_t time)
+{
+    if (2 * (count + 1) > slots.size()) grow();
+    std::size_t i = home(key);
+    while (slots[i].key != emptyKey) i = (i + 1) & mask;
+    slots[i].key = key;
+    slots[i].time = time;
+    count++;
+}
+
+bool FlatEdgeMap::erase(Key key)
+{
+    std::size_t i = home(key);
+    while (slots[i].key != key) {
+        if (slots[i].key == emptyKey) return false;
+        i = (i + 1) & mask;
+    }
+
+    // Backward shift: walk the rest of the run, and pull back every entry that may
+    //   legally sit in the hole (i.e., its home isn't cyclically after the hole)
+    for (std::size_t j = (i + 1) & mask; slots[j].key != emptyKey; j = (j + 1) & mask) {
+        std::size_t h = home(slots[j].key);
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].key = emptyKey;
+    count--;
+    return true;
+}
+
+void FlatEdgeMap::grow()
+{
+    std::vector<Slot> old(2 * slots.size(), Slot{emptyKey, 0});
+    old.swap(slots);
+    mask = slots.size() - 1;
+    shift--;
+    for (const Slot &s : old) {
+        if (s.key == emptyKey) continue;
+        std::size_t i = home(s.key);
+        while (slots[i].key != emptyKey) i = (i + 1) & mask;
+        slots[i] = s;
+    }
+}
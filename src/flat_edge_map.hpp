@@ -0,0 +1,47 @@
+#ifndef flat_edge_map_hpp
+#define flat_edge_map_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <time.h>
+
+// Edge -> time of the latest payment along it, as one flat open-addressing hash table
+//   with linear probing: no node per edge, and a lookup is a multiply plus (usually)
+//   a single cache line. Edges are erased all the time as they fall out of the window,
+//   so deletion shifts the rest of the probe run back instead of leaving tombstones,
+//   and the table never has to be cleaned up.
+class FlatEdgeMap {
+public:
+    using Key = std::uint64_t; // a packed pair of vertex ids; the all-ones key is reserved
+
+    FlatEdgeMap();
+
+    // the time stored for key, or null if there is none (only valid until the next change)
+    time_t *find(Key key);
+    // key must not be in the map yet
+    void insert(Key key, time_t time);
+    // returns false if key wasn't there
+    bool erase(Key key);
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+private:
+    static const Key emptyKey = ~Key(0);
+
+    struct Slot {
+        Key key;
+        time_t time;
+    };
+
+    std::size_t home(Key key) const
+    { return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> shift); } // Fibonacci hashing
+    void grow();
+
+    std::vector<Slot> slots; // power-of-two size, never more than half full
+    std::size_t mask;
+    unsigned shift;          // 64 - log2(slots.size())
+    std::size_t count;
+};
+
+#endif /* flat_edge_map_hpp */
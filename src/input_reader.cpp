@@ -0,0 +1,231 @@
+#include "input_reader.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h> // POSIX
+
+namespace {
+    // size of each read in streaming mode
+    const std::size_t blockSize = 1 << 20;
+    // room in front of each block for the unfinished record of the previous one;
+    //   a record longer than this just grows the block
+    const std::size_t headroom = 1 << 16;
+    // how far ahead of the cursor the mapping gets paged in (a multiple of the page size)
+    const std::size_t prefetchWindow = 8 << 20;
+}
+
+InputReader::InputReader(const char *path)
+: fd(-1), ownsFd(false), mapped(nullptr), mappedSize(0), prefetched(nullptr), cursor(nullptr), limit(nullptr),
+  current(1), atEof(false), format(Decompressor::Uncompressed), rawCursor(nullptr), rawLimit(nullptr), rawEof(false),
+  requested(false), ready(false), stopping(false)
+{
+    if (path) fd = open(path, O_RDONLY);
+    if (fd >= 0) ownsFd = true;
+    else fd = STDIN_FILENO; // read from stdin if file is invalid
+
+    // map regular files whole; everything else goes through the streaming path
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            mapped = static_cast<const char*>(p);
+            mappedSize = st.st_size;
+            madvise(p, mappedSize, MADV_SEQUENTIAL); // only a hint; failure is harmless
+        }
+    }
+
+    if (mapped) {
+        format = Decompressor::detect(mapped, mappedSize);
+        if (format == Decompressor::Uncompressed) {
+            prefetched = mapped;
+            cursor = mapped;
+            limit = mapped + mappedSize;
+            atEof = true; // nothing more to read beyond the mapping
+            return;
+        }
+        // the mapping is what gets decompressed
+        rawCursor = mapped;
+        rawLimit = mapped + mappedSize;
+        rawEof = true;
+    } else {
+        // peek at the start of the stream; it's handed out first if it isn't compressed
+        raw.resize(blockSize);
+        std::size_t n = 0, k;
+        while (n < 4 && (k = readSome(raw.data() + n, raw.size() - n)) > 0) n += k;
+        rawCursor = raw.data();
+        rawLimit = rawCursor + n;
+        format = Decompressor::detect(rawCursor, n);
+    }
+
+    if (format != Decompressor::Uncompressed) {
+        decompressor = Decompressor::create(format);
+        if (!decompressor) {
+            atEof = true; // isReadable() tells why there's nothing to read
+            return;
+        }
+    }
+
+    // start reading the first block right away
+    ioThread = std::thread(&InputReader::ioLoop, this);
+    requestBlock();
+}
+
+InputReader::~InputReader()
+{
+    if (ioThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(ioMutex);
+            stopping = true;
+        }
+        ioCv.notify_all();
+        ioThread.join(); // waits for a read in progress, if any
+    }
+    if (mapped) munmap(const_cast<char*>(mapped), mappedSize);
+    if (ownsFd) close(fd);
+}
+
+bool InputReader::next(StringRef &record, RecordIndex &idx)
+{
+    if (isMapped()) prefetchMapped();
+    while (true) {
+        const char *nl = cursor ? scanner.scanRecord(cursor, limit, idx) : limit;
+        if (nl != limit) {
+            record = StringRef(cursor, nl);
+            cursor = nl + 1;
+            break;
+        }
+        // no complete line left in the window: try to get more, else hand out the tail
+        if (atEof || !fill()) {
+            if (cursor == limit) return false;
+            record = StringRef(cursor, limit); // last line without a terminator
+            cursor = limit;
+            break;
+        }
+    }
+    // tolerate DOS line endings
+    if (!record.empty() && record[record.size - 1] == '\r') record.size--;
+    return true;
+}
+
+void InputReader::prefetchMapped()
+{
+    // MADV_WILLNEED starts the reads and returns, so the disk works while we parse
+    if (prefetched < limit && cursor + prefetchWindow / 2 > prefetched) {
+        std::size_t n = std::size_t(limit - prefetched) < prefetchWindow ? limit - prefetched : prefetchWindow;
+        madvise(const_cast<char*>(prefetched), n, MADV_WILLNEED); // only a hint, too
+        prefetched += n;
+    }
+}
+
+void InputReader::requestBlock()
+{
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        requested = true;
+    }
+    ioCv.notify_all();
+}
+
+void InputReader::ioLoop()
+{
+    while (true) {
+        Block *b;
+        {
+            std::unique_lock<std::mutex> lock(ioMutex);
+            ioCv.wait(lock, [this] { return requested || stopping; });
+            if (stopping) return;
+            b = &blocks[1 - current]; // the reader doesn't touch that one until it's ready
+        }
+
+        if (b->data.size() < headroom + blockSize) b->data.resize(headroom + blockSize);
+        b->size = produce(b->data.data() + headroom, blockSize);
+
+        {
+            std::lock_guard<std::mutex> lock(ioMutex);
+            requested = false;
+            ready = true;
+        }
+        ioCv.notify_all();
+    }
+}
+
+std::size_t InputReader::readSome(char *out, std::size_t n)
+{
+    ssize_t k;
+    do {
+        k = read(fd, out, n);
+    } while (k < 0 && errno == EINTR);
+    return k > 0 ? k : 0; // a read error ends the input, like end of file
+}
+
+std::size_t InputReader::produce(char *out, std::size_t n)
+{
+    if (!decompressor) {
+        // what was read while peeking goes first
+        if (rawCursor < rawLimit) {
+            std::size_t k = std::size_t(rawLimit - rawCursor) < n ? rawLimit - rawCursor : n;
+            std::memcpy(out, rawCursor, k);
+            rawCursor += k;
+            return k;
+        }
+        return readSome(out, n);
+    }
+
+    // fill the whole block, reading more compressed input as needed
+    std::size_t produced = 0;
+    while (produced < n && !decompressor->failed()) {
+        if (rawCursor == rawLimit) {
+            std::size_t k = rawEof ? 0 : readSome(raw.data(), raw.size());
+            if (k == 0) {
+                rawEof = true;
+                break;
+            }
+            rawCursor = raw.data();
+            rawLimit = rawCursor + k;
+        }
+        produced += decompressor->run(rawCursor, rawLimit, out + produced, n - produced);
+    }
+
+    // this is the end of the input, so say if it ended early
+    if (produced == 0) {
+        if (decompressor->failed())
+            std::cerr << "Corrupt " << Decompressor::formatName(format) << " input; stopping there!" << std::endl;
+        else if (!decompressor->atStreamEnd())
+            std::cerr << "Truncated " << Decompressor::formatName(format) << " input; stopping there!" << std::endl;
+    }
+    return produced;
+}
+
+bool InputReader::fill()
+{
+    // wait for the block the I/O thread has been reading
+    {
+        std::unique_lock<std::mutex> lock(ioMutex);
+        ioCv.wait(lock, [this] { return ready; });
+        ready = false;
+    }
+    Block &b = blocks[1 - current];
+    if (b.size == 0) {
+        atEof = true;
+        return false; // the unconsumed tail stays where it is
+    }
+
+    // put the unconsumed tail of the current block right in front of the new data
+    std::size_t tail = cursor ? limit - cursor : 0;
+    std::size_t start = headroom;
+    if (tail > headroom) {
+        b.data.insert(b.data.begin() + headroom, tail - headroom, '\0');
+        start = tail;
+    }
+    if (tail) std::memcpy(b.data.data() + start - tail, cursor, tail);
+    cursor = b.data.data() + start - tail;
+    limit = b.data.data() + start + b.size;
+
+    // the old block is free now: have the next block read into it while this one is parsed
+    current = 1 - current;
+    requestBlock();
+    return true;
+}
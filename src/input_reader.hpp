@@ -0,0 +1,101 @@
+#ifndef input_reader_hpp
+#define input_reader_hpp
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "decompressor.hpp"
+#include "string_ref.hpp"
+#include "structural_scan.hpp"
+
+// Hands out the input one record (line) at a time, without copying it.
+//   Regular files are memory-mapped, so a record is simply a view into the mapping,
+//   and stays valid for the lifetime of the reader. Anything that cannot be mapped
+//   (stdin, pipes, FIFOs) is read in large blocks instead; in that case a record only
+//   stays valid until the next call to next().
+// Either way, input is brought in ahead of the parser: the kernel is asked to page in
+//   the mapping a window ahead of the cursor, and streamed input is double buffered,
+//   with an I/O thread reading the next block while records are handed out of the
+//   current one.
+// Compressed input (gzip or zstd, told apart by its first bytes) is decompressed on
+//   that same I/O thread, straight into the blocks, whether it was mapped or streamed.
+class InputReader {
+public:
+    // a null path, or one that cannot be opened, reads from stdin instead
+    explicit InputReader(const char *path);
+    ~InputReader();
+
+    InputReader(const InputReader&) = delete;
+    InputReader& operator=(const InputReader&) = delete;
+
+    // get the next record, without its line terminator; returns false at end of input.
+    //   The structural index of the record comes along for free, since that's how we
+    //   find where it ends.
+    bool next(StringRef &record, RecordIndex &idx);
+    bool next(StringRef &record) { RecordIndex idx; return next(record, idx); }
+
+    // records are views into a mapping of the (uncompressed) input
+    bool isMapped() const { return mapped != nullptr && format == Decompressor::Uncompressed; }
+    // the whole mapped input (empty unless isMapped())
+    StringRef contents() const { return isMapped() ? StringRef(mapped, mappedSize) : StringRef(); }
+
+    Decompressor::Format compression() const { return format; }
+    // false if the input is compressed in a format this build can't read
+    bool isReadable() const { return format == Decompressor::Uncompressed || decompressor; }
+private:
+    // one of the two streaming buffers; data is read in after some headroom,
+    //   so the unconsumed tail of the other buffer can be put in front of it
+    struct Block {
+        std::vector<char> data;
+        std::size_t size;
+    };
+
+    // streaming fallback: switch to the next block, returns false if nothing more could be read
+    bool fill();
+    // ask the I/O thread to read into the block that isn't current
+    void requestBlock();
+    void ioLoop();
+    // on the I/O thread: up to n more bytes of (decompressed) input; 0 at the end
+    std::size_t produce(char *out, std::size_t n);
+    // read() whatever is available, up to n bytes; 0 at the end (or on an error)
+    std::size_t readSome(char *out, std::size_t n);
+    // mapped input: page in the next window if the cursor is getting close to it
+    void prefetchMapped();
+
+    int fd;
+    bool ownsFd;
+    StructuralScanner scanner;
+
+    // memory-mapped input
+    const char *mapped;
+    std::size_t mappedSize;
+    const char *prefetched; // the kernel has been asked for everything before this
+
+    // current window of unconsumed input (either into the mapping or into the buffer)
+    const char *cursor;
+    const char *limit;
+
+    // streaming input
+    Block blocks[2];
+    int current; // the block cursor points into
+    bool atEof;
+
+    // compressed input, or (for streams) whatever was read to tell whether it's compressed
+    Decompressor::Format format;
+    std::unique_ptr<Decompressor> decompressor;
+    std::vector<char> raw;
+    const char *rawCursor;
+    const char *rawLimit;
+    bool rawEof;
+
+    // I/O thread state, guarded by ioMutex
+    std::thread ioThread;
+    std::mutex ioMutex;
+    std::condition_variable ioCv;
+    bool requested, ready, stopping;
+};
+
+#endif /* input_reader_hpp */
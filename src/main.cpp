@@ -7,51 +7,410 @@
 //
 
 #include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <thread>
+#include <vector>
 #include "treap.hpp"
 #include "median_degree.hpp"
+#include "input_reader.hpp"
+#include "median_writer.hpp"
+#include "parallel_parser.hpp"
+#include "record_status.hpp"
+#include "replay_file.hpp"
+#include "timestamp.hpp"
+#include "venmo_parser.hpp"
+#include "windowed_medians.hpp"
 
+namespace {
+    // when a line of output is due
+    enum class OutputMode {
+        EveryRecord, // after every payment (the default)
+        EveryN,      // after every N-th payment
+        EveryT,      // after the first payment of every T seconds of event time
+        OnChange     // whenever the output changes, with the index of the record that changed it
+    };
+    
+    // command line settings; everything that isn't an option is a file name
+    struct Options {
+        const char *inputPath = nullptr;
+        const char *outputPath = nullptr;
+        unsigned threads = 1; // parser threads; 1 parses on the main thread
+        MedianBackend median = MedianBackend::Histogram;
+        std::vector<double> quantiles; // extra columns after the median
+        std::vector<double> windowSeconds; // lengths; just the one minute, if none given
+        double lateSeconds = -1;           // how late a payment may be; negative: up to the window
+        unsigned ticksPerSecond = 1;       // time resolution
+        // the same, in ticks, once the command line is all read
+        std::vector<time_t> windows;
+        time_t maxLateness = std::numeric_limits<time_t>::max();
+        OutputMode output = OutputMode::EveryRecord;
+        std::uint64_t everyRecords = 1; // N, for OutputMode::EveryN
+        double everySeconds = 0;        // T, for OutputMode::EveryT
+        time_t everyTicks = 0;          // the same, in ticks
+        std::size_t top = 0;            // highest-degree vertices to list on each line
+        bool toReplay = false;   // convert the input to a replay file instead
+        bool fromReplay = false; // the input is a replay file
+    };
 
-int main(int argc, const char * argv[]) {
+    void usage(const char *prog)
+    {
+        std::cerr << "usage: " << prog << " [options] [input-file [output-file]]\n"
+                  << "  --threads=N   parse with N worker threads (0: one per core)\n"
+                  << "  --median=KIND keep the median with a 'histogram' (default), a 'treap' or a 'btree'\n"
+                  << "  --quantiles=Q,... after the median, also print the degree at each quantile Q\n"
+                  << "                (between 0 and 1, or 'max'), one column each\n"
+                  << "  --windows=S,... keep a graph for each window length S (in seconds; default 60),\n"
+                  << "                and print the columns for each in turn\n"
+                  << "  --late=S      ignore payments more than S seconds behind the latest one\n"
+                  << "                (by default, anything still inside the window counts)\n"
+                  << "  --millis      keep time to the millisecond instead of the second\n"
+                  << "  --every=N     print only after every N-th payment\n"
+                  << "  --every-seconds=T  print after the first payment of every T seconds\n"
+                  << "                of event time, preceded by the record's index\n"
+                  << "  --on-change   print only when the output changes, preceded by the\n"
+                  << "                index of the record that changed it\n"
+                  << "  --top=K       end each line with the K highest-degree vertices of each\n"
+                  << "                window, as name:degree\n"
+                  << "  --to-replay   convert the input to a binary replay file, written to the output\n"
+                  << "  --replay      the input is a replay file made by --to-replay\n";
+    }
+
+    // a comma-separated list of quantiles; returns false if it makes no sense
+    bool parseQuantiles(const char *list, std::vector<double> &quantiles)
+    {
+        while (true) {
+            double q;
+            char *end;
+            if (std::strncmp(list, "max", 3) == 0) {
+                q = 1;
+                end = const_cast<char*>(list + 3);
+            } else {
+                q = std::strtod(list, &end);
+                if (end == list || !(q >= 0 && q <= 1)) return false;
+            }
+            quantiles.push_back(q);
+            if (*end == '\0') return true;
+            if (*end != ',') return false;
+            list = end + 1;
+        }
+    }
     
-    MedianDegreeStruct m;
-    // argv[1] will be the input file
-    // argv[2] will be the output file
-    // if none provided, output file will be to stdout
+    // a comma-separated list of window lengths in seconds; returns false if it makes no sense
+    bool parseWindows(const char *list, std::vector<double> &windows)
+    {
+        while (true) {
+            char *end;
+            double w = std::strtod(list, &end);
+            if (end == list || !(w > 0)) return false;
+            windows.push_back(w);
+            if (*end == '\0') return true;
+            if (*end != ',') return false;
+            list = end + 1;
+        }
+    }
     
+    // A number of seconds as a whole number of ticks, rounding to the nearest; returns false
+    //   if that is more than a time can hold with room to spare (the windows are taken off
+    //   times, and those are in the trillions already with milliseconds).
+    bool toTicks(double seconds, unsigned ticksPerSecond, time_t &ticks)
+    {
+        const double maxTicks = 1e15;
+        double t = seconds * ticksPerSecond;
+        if (!(t < maxTicks)) return false;
+        ticks = static_cast<time_t>(std::llround(t));
+        return true;
+    }
     
-    // set up file streams; command line arguments give it
-    std::fstream infile0;
-    if (argc > 0) infile0.open(argv[1],std::fstream::in);
-    std::fstream outfile0;
-    if (argc > 1) outfile0.open(argv[2],std::fstream::out);
+    // whether two rows print the same; interpolated quantiles can differ in the last bits
+    //   and still round alike
+    bool samePrinted(const std::vector<double> &a, const std::vector<double> &b)
+    {
+        if (a.size() != b.size()) return false;
+        for (std::size_t i = 0; i < a.size(); i++) {
+            if (a[i] == b[i]) continue;
+            char x[32], y[32];
+            std::snprintf(x, sizeof x, "%.2f", a[i]);
+            std::snprintf(y, sizeof y, "%.2f", b[i]);
+            if (std::strcmp(x, y) != 0) return false;
+        }
+        return true;
+    }
     
-    std::istream& infile = infile0? infile0 : std::cin; // read from stdin if file is invalid
-    std::ostream& outfile = outfile0? outfile0 : std::cout; // write to stdout if file is invalid
+    // a / b, rounded down even for times before the Epoch
+    std::int64_t floorDiv(std::int64_t a, std::int64_t b)
+    {
+        std::int64_t q = a / b;
+        return q * b > a ? q - 1 : q;
+    }
     
-    while (!infile.eof()) {
-        nlohmann::json j;
-        
-        // get strings from file line-by-line
-        // this JSON reader package insists on deserializing them one at a time
-        std::string s;
-        std::getline(infile,s);
-        // if it is a blank line, keep going
-        if (s.empty()) continue;
-        
-        // process the string as a single line
-        std::stringstream ss(s);
+    // returns false if the command line makes no sense
+    bool parseOptions(int argc, const char *argv[], Options &opts)
+    {
+        int positional = 0;
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            if (std::strncmp(arg, "--threads=", 10) == 0) {
+                char *end;
+                opts.threads = static_cast<unsigned>(std::strtoul(arg + 10, &end, 10));
+                if (end == arg + 10 || *end != '\0') return false;
+                if (opts.threads == 0) opts.threads = std::thread::hardware_concurrency();
+            } else if (std::strcmp(arg, "--median=histogram") == 0) {
+                opts.median = MedianBackend::Histogram;
+            } else if (std::strcmp(arg, "--median=treap") == 0) {
+                opts.median = MedianBackend::Treap;
+            } else if (std::strcmp(arg, "--median=btree") == 0) {
+                opts.median = MedianBackend::BTree;
+            } else if (std::strncmp(arg, "--quantiles=", 12) == 0) {
+                if (!parseQuantiles(arg + 12, opts.quantiles)) return false;
+            } else if (std::strncmp(arg, "--windows=", 10) == 0) {
+                if (!parseWindows(arg + 10, opts.windowSeconds)) return false;
+            } else if (std::strncmp(arg, "--late=", 7) == 0) {
+                char *end;
+                opts.lateSeconds = std::strtod(arg + 7, &end);
+                if (end == arg + 7 || *end != '\0' || !(opts.lateSeconds >= 0)) return false;
+            } else if (std::strcmp(arg, "--millis") == 0) {
+                opts.ticksPerSecond = 1000;
+            } else if (std::strncmp(arg, "--every=", 8) == 0) {
+                char *end;
+                opts.everyRecords = std::strtoull(arg + 8, &end, 10);
+                if (end == arg + 8 || *end != '\0' || opts.everyRecords == 0) return false;
+                opts.output = OutputMode::EveryN;
+            } else if (std::strncmp(arg, "--every-seconds=", 16) == 0) {
+                char *end;
+                opts.everySeconds = std::strtod(arg + 16, &end);
+                if (end == arg + 16 || *end != '\0' || !(opts.everySeconds > 0)) return false;
+                opts.output = OutputMode::EveryT;
+            } else if (std::strncmp(arg, "--top=", 6) == 0) {
+                char *end;
+                opts.top = static_cast<std::size_t>(std::strtoull(arg + 6, &end, 10));
+                if (end == arg + 6 || *end != '\0') return false;
+            } else if (std::strcmp(arg, "--on-change") == 0) {
+                opts.output = OutputMode::OnChange;
+            } else if (std::strcmp(arg, "--to-replay") == 0) {
+                opts.toReplay = true;
+            } else if (std::strcmp(arg, "--replay") == 0) {
+                opts.fromReplay = true;
+            } else if (std::strncmp(arg, "--", 2) == 0) {
+                return false;
+            } else if (positional == 0) {
+                opts.inputPath = arg;
+                positional++;
+            } else if (positional == 1) {
+                opts.outputPath = arg;
+                positional++;
+            } else {
+                return false;
+            }
+        }
+        if (opts.windowSeconds.empty()) opts.windowSeconds.push_back(60);
+        for (double w : opts.windowSeconds) {
+            time_t ticks;
+            if (!toTicks(w, opts.ticksPerSecond, ticks) || ticks < 1) return false; // too long, or shorter than a tick
+            opts.windows.push_back(ticks);
+        }
+        if (opts.lateSeconds >= 0 && !toTicks(opts.lateSeconds, opts.ticksPerSecond, opts.maxLateness)) return false;
+        if (opts.output == OutputMode::EveryT) {
+            if (!toTicks(opts.everySeconds, opts.ticksPerSecond, opts.everyTicks)) return false;
+            if (opts.everyTicks < 1) return false; // shorter than a tick
+        }
+        return !(opts.toReplay && opts.fromReplay);
+    }
+    
+    // parse the input once and store it in replay form; no medians are computed
+    void convertToReplay(InputReader &reader, const char *outputPath)
+    {
+        VenmoParser parser;
+        TimestampDecoder timeDecoder(ReplayRecord::ticksPerSecond);
+        ReplayWriter out(outputPath);
         
-        // deserialize the JSON object
-        ss >> j;
+        StringRef record;
+        RecordIndex idx;
+        while (reader.next(record, idx)) {
+            if (record.empty()) continue;
+            
+            // skipped records are kept too, so that replaying counts them the same way
+            VenmoRecord r;
+            RecordStatus status = parser.parse(record, idx, r);
+            time_t t;
+            if (status == RecordStatus::Ok && !timeDecoder.decode(r.createdTime, t)) status = RecordStatus::BadTimestamp;
+            else if (status == RecordStatus::Ok && r.actor.empty()) status = RecordStatus::EmptyActor;
+            else if (status == RecordStatus::Ok && r.target.empty()) status = RecordStatus::EmptyTarget;
+            else if (status == RecordStatus::Ok && r.actor == r.target) status = RecordStatus::SelfPayment;
+            
+            if (status == RecordStatus::Ok) out.add(t, r.actor, r.target);
+            else out.addSkipped(status);
+        }
+        out.finish();
+    }
+}
+
+
+int main(int argc, const char * argv[]) {
+    
+    VenmoParser parser;
+    // the first file name will be the input file
+    // the second file name will be the output file
+    // if none provided, input will be from stdin and output to stdout
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    // set up the input reader and output writer; command line arguments give them
+    InputReader reader(opts.inputPath); // reads from stdin if file is invalid
+    if (!reader.isReadable()) {
+        std::cerr << "Input is " << Decompressor::formatName(reader.compression())
+                  << "-compressed, but this build can't decompress that!" << std::endl;
+        return 1;
+    }
+    if (opts.toReplay) {
+        convertToReplay(reader, opts.outputPath);
+        return 0;
+    }
+    MedianWriter writer(opts.outputPath); // writes to stdout if file is invalid
+    WindowedMedians m(opts.windows, opts.median, opts.maxLateness, opts.ticksPerSecond);
+    if (opts.top > 0) m.trackTopDegrees();
+    
+    // the median, and then whatever else was asked for, for each window
+    std::vector<double> columns(1, 0.5);
+    columns.insert(columns.end(), opts.quantiles.begin(), opts.quantiles.end());
+    std::vector<double> row, values, lastRow;
+    auto fillRow = [&]() {
+        row.clear();
+        for (std::size_t i = 0; i < m.size(); i++) {
+            if (opts.quantiles.empty()) {
+                row.push_back(m.window(i).getMedianDegree()); // the quick way
+                continue;
+            }
+            m.window(i).getDegreeQuantiles(columns, values);
+            row.insert(row.end(), values.begin(), values.end());
+        }
+    };
+    // the top vertices go after the numbers, as " name:degree" for each
+    std::string tail, lastTail;
+    std::vector<MedianDegreeStruct::DegName> top;
+    auto fillTail = [&]() {
+        tail.clear();
+        if (opts.top == 0) return;
+        for (std::size_t i = 0; i < m.size(); i++) {
+            m.window(i).getTopDegrees(opts.top, top);
+            for (const MedianDegreeStruct::DegName &t : top) {
+                StringRef name = m.names().name(t.second);
+                tail += ' ';
+                tail.append(name.data, name.size);
+                tail += ':';
+                tail += std::to_string(t.first);
+            }
+        }
+    };
+    
+    // the sampled modes only look the median up when a line is due
+    std::uint64_t records = 0, payments = 0; // every record, and just the ones that count
+    time_t nextDue = 0;                      // for OutputMode::EveryT
+    std::vector<std::uint64_t> versions(m.size(), 0); // for OutputMode::OnChange
+    auto changed = [&]() {
+        bool any = false;
+        for (std::size_t i = 0; i < m.size(); i++) {
+            if (m.window(i).version() != versions[i]) any = true;
+            versions[i] = m.window(i).version();
+        }
+        return any;
+    };
+    
+    // report the new median after each transaction (or as often as asked), or count
+    //   why it was skipped
+    SkipCounts skipped;
+    auto report = [&](RecordStatus status) {
+        records++;
+        if (status != RecordStatus::Ok) {
+            skipped.add(status);
+            return;
+        }
+        payments++;
+        switch (opts.output) {
+            case OutputMode::EveryRecord:
+                break;
+            case OutputMode::EveryN:
+                if (payments % opts.everyRecords != 0) return;
+                break;
+            case OutputMode::EveryT:
+                if (payments > 1 && m.latest() < nextDue) return;
+                nextDue = (floorDiv(m.latest(), opts.everyTicks) + 1) * opts.everyTicks;
+                fillRow();
+                fillTail();
+                writer.writeRow(records, row, StringRef(tail.data(), tail.size()));
+                return;
+            case OutputMode::OnChange:
+                // only an edge coming or going can move the median; and even then it may stay put
+                if (!changed()) return;
+                fillRow();
+                fillTail();
+                if (samePrinted(row, lastRow) && tail == lastTail) return;
+                writer.writeRow(records, row, StringRef(tail.data(), tail.size()));
+                lastRow.swap(row);
+                lastTail.swap(tail);
+                return;
+        }
+        if (m.size() == 1 && opts.quantiles.empty() && opts.top == 0) {
+            writer.writeMedian(m.window(0).getMedianDegree()); // use NaN when empty
+        } else {
+            fillRow();
+            fillTail();
+            writer.writeRow(row, StringRef(tail.data(), tail.size()));
+        }
+    };
+    
+    if (opts.fromReplay) {
+        // a replay file is used where it lies, so it has to be mapped too
         try {
-            m.insert(j);
-            outfile << std::fixed << std::setprecision(2) << m.getMedianDegree() << '\n'; // use NaN when empty
-        } catch(EmptyActorException&) {
-            std::cerr << "Empty actor encountered; skipping!" << std::endl;
+            if (!reader.isMapped()) throw BadReplayException();
+            ReplayReader replay(reader.contents());
+            // the dictionary goes in first, in order, so that the file's name ids are the graph's
+            const std::vector<StringRef> &dict = replay.dictionary();
+            for (std::size_t i = 0; i < dict.size(); i++)
+                if (m.names().intern(dict[i]) != i) throw BadReplayException(); // a repeated name
+            
+            // the file keeps milliseconds; round down to our ticks
+            const std::int64_t perTick = ReplayRecord::ticksPerSecond / opts.ticksPerSecond;
+            ReplayRecord r;
+            while (replay.next(r)) {
+                if (r.time == ReplayRecord::skipped) {
+                    report(static_cast<RecordStatus>(r.actor));
+                } else {
+                    report(m.insert(static_cast<time_t>(floorDiv(r.time, perTick)), r.actor, r.target));
+                }
+            }
+        } catch(BadReplayException&) {
+            std::cerr << "Input is not a complete replay file (or not an uncompressed regular file)!" << std::endl;
+            return 1;
+        }
+    } else if (opts.threads > 1 && reader.isMapped()) {
+        // parallel parsing needs the whole input in memory, i.e., mapped
+        ParallelParser pp(reader.contents(), opts.threads, opts.ticksPerSecond);
+        pp.run([&](const ParsedTransaction &t) {
+            report(t.status == RecordStatus::Ok ? m.insert(t.time, t.actor, t.target) : t.status);
+        });
+    } else {
+        // each record is handed to us in place (no per-line std::string or stringstream)
+        StringRef record;
+        RecordIndex idx;
+        while (reader.next(record, idx)) {
+            // if it is a blank line, keep going
+            if (record.empty()) continue;
+            
+            // pick out the fields we need; only unusual records get a full JSON parse
+            VenmoRecord r;
+            RecordStatus status = parser.parse(record, idx, r);
+            report(status == RecordStatus::Ok ? m.insert(r) : status);
         }
     }
+    
+    skipped.report(std::cerr);
 }
@@ -1,112 +1,273 @@
 #include "median_degree.hpp"
 #include "treap.hpp"
-#include <chrono>
+#include <algorithm>
+#include <cmath>
 #include <time.h>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 
-inline double dateDiff(const MedianDegreeStruct::Transaction& lhs, const MedianDegreeStruct::Transaction& rhs)
-{
-    return difftime(lhs.first,rhs.first);
-}
-
-void MedianDegreeStruct::insert(const nlohmann::json &j)
-{
-    // get date and time of transaction as a UNIX time
-    const char *dateFmt = "%Y-%m-%dT%H:%M:%SZ";
-    std::string dateString = j["created_time"];
-    tm transactionTimeStruct;
-    strptime(dateString.c_str(), dateFmt, &transactionTimeStruct);
-    
-    time_t transactionTime = timegm(&transactionTimeStruct);
+namespace {
+    // The order-statistics trees (MedianMap and MedianBTree) share an interface, and are
+    //   kept up to date the same way.
     
-    // get actor; throw exception if invalid
-    std::string actor = j["actor"];
-    if (actor.empty()) throw EmptyActorException();
+    // move a vertex to its new degree [disallow zero]
+    template <class Tree>
+    void moveDegree(Tree &tree, MedianDegreeStruct::VertexId v, int oldDeg, int newDeg)
+    {
+        if (oldDeg == 0) tree.insert(std::make_pair(newDeg,v), /*unused*/ 0);
+        else if (newDeg == 0) tree.remove(std::make_pair(oldDeg,v));
+        else tree.rekey(std::make_pair(oldDeg,v), std::make_pair(newDeg,v));
+    }
     
-    // get target (could do exception handling here, too)
-    std::string target = j["target"];
+    // drop a sorted batch of vertices, and move others
+    template <class Tree>
+    void applyBatch(Tree &tree, const std::vector<MedianDegreeStruct::DegName> &dropped,
+                    const std::vector<std::pair<MedianDegreeStruct::DegName,MedianDegreeStruct::DegName>> &rekeyed)
+    {
+        tree.removeSorted(dropped.begin(), dropped.end());
+        tree.rekey(rekeyed.begin(), rekeyed.end());
+    }
     
-    // Canonization procedure: to assist in non-directedness of the graph, always make
-    //   the lexicographically first name the "actor", i.e., whether the actor is Bob or Alice.
-    //   and the target is Alice or Bob, the pair is always going to be (Alice,Bob).
+    // The k largest degrees, largest first, and among equal degrees the lower id first: all
+    //   of the vertices above the lowest degree that makes it, and the first few of that one.
+    template <class Tree>
+    void topOf(const Tree &tree, std::size_t k, std::vector<int> &ranks, std::vector<MedianDegreeStruct::DegName> &top)
+    {
+        using DegName = MedianDegreeStruct::DegName;
+        int n = tree.size();
+        int first = k < static_cast<std::size_t>(n) ? n - static_cast<int>(k) : 0;
+        top.clear();
+        if (first == n) return;
+        int d = tree.orderStatistic(first).first.first;
+        int from = tree.rank(DegName(d, 0)), above = tree.rank(DegName(d + 1, 0));
+        ranks.clear();
+        for (int r = from; r < from + above - first; r++) ranks.push_back(r);
+        for (int r = above; r < n; r++) ranks.push_back(r);
+        tree.select(ranks, top);
+        // that is by degree and then id, both going up; turn the degrees around
+        std::reverse(top.begin(), top.end());
+        for (auto run = top.begin(); run != top.end(); ) {
+            auto end = run;
+            while (end != top.end() && end->first == run->first) ++end;
+            std::reverse(run, end);
+            run = end;
+        }
+    }
     
-    if (actor > target) std::swap(actor,target);
+    template <class Tree>
+    double medianOf(const Tree &tree)
+    {
+        int n = tree.size();
+        if (n <= 0) return 0.0/0.0; // NaN
+        if (n % 2) return tree.orderStatistic(n/2).first.first; // truncates
+        return 0.5 * (tree.orderStatistic(n/2 - 1).first.first + tree.orderStatistic(n/2).first.first);
+    }
+}
+
+RecordStatus MedianDegreeStruct::insert(time_t transactionTime, VertexId actor, VertexId target)
+{
+    if (actor == target) return RecordStatus::SelfPayment;
     
-    Transaction t = std::make_pair(transactionTime, std::make_pair(actor,target));
+    // Canonization procedure: to assist in non-directedness of the graph, the edge key
+    //   is the same whether the actor is Bob or Alice and the target is Alice or Bob.
+    EdgeKey edge = edgeKey(actor, target);
     
-    if (!transactions.empty()) { // latest element is at the very end
-        auto latest = transactions.rbegin();
-        if (dateDiff(*latest,t) >= 60.0) return; // reject it
-        evictOldTransactions(t);
+    if (!transactions.empty()) {
+        // too old for the window, or later than we wait for: reject it (the median still gets reported)
+        time_t behind = transactions.latest() - transactionTime;
+        if (behind >= window || behind > maxLateness) return RecordStatus::Ok;
+        evictOldTransactions(transactionTime);
     }
         
     
     // check to see if the edge is already in the graph
-    auto graphEntry = graph.find(t.second);
+    time_t *edgeTime = graph.find(edge);
     // if it's not, then update the degrees
-    if (graphEntry == graph.end()) {
+    if (!edgeTime) {
+        // make room for people we haven't seen before (the ids may come from someone else's names())
+        VertexId newest = std::max(actor, target);
+        if (degMap.size() <= newest) degMap.resize(newest + 1, 0);
+        
         // increment their degrees
         int da = degMap[actor]++;
         int dt = degMap[target]++;
         
-        // remove them from the median tree
-        medMap.remove(std::make_pair(da,actor));
-        medMap.remove(std::make_pair(dt,target));
+        // move them up in the median tree
+        changeDegree(actor, da, da+1);
+        changeDegree(target, dt, dt+1);
         
-        // insert new values into the median tree
-        medMap.insert(std::make_pair(da+1,actor),0);
-        medMap.insert(std::make_pair(dt+1,target),0);
-    } else { // if so, merely update the timestamps
-        // erase the old time
-        transactions.erase(std::make_pair(graphEntry->second,graphEntry->first));
+        graph.insert(edge, transactionTime); // create a new entry
+        degreeChanges++;
+    } else if (*edgeTime != transactionTime) { // if so, merely update the timestamps
+        // the old entry goes stale
+        time_t before = *edgeTime;
+        *edgeTime = transactionTime;
+        transactions.supersede(before, [this](EdgeKey e, time_t when) {
+            time_t *t = graph.find(e);
+            return t && *t == when;
+        });
+    } else {
+        return RecordStatus::Ok; // same edge, same second: nothing changes
     }
     
-    graph[t.second] = t.first; // create a new entry or update time
     // insert the new entry into the transactions
-    transactions.insert(t);
+    transactions.add(edge, transactionTime);
+    return RecordStatus::Ok;
+}
+
+void MedianDegreeStruct::changeDegree(VertexId v, int oldDeg, int newDeg)
+{
+    if (backend == MedianBackend::Histogram) {
+        medHist.change(oldDeg, newDeg);
+        if (topTracked) topBuckets.change(v, oldDeg, newDeg);
+        return;
+    }
+    if (backend == MedianBackend::BTree) moveDegree(medTree, v, oldDeg, newDeg);
+    else moveDegree(medMap, v, oldDeg, newDeg);
+}
+
+void MedianDegreeStruct::applyEvictions()
+{
+    // a vertex may have lost several edges; its first entry has the degree it started from
+    std::sort(evicted.begin(), evicted.end(), [](const std::pair<VertexId,int> &a, const std::pair<VertexId,int> &b) {
+        return a.first < b.first || (a.first == b.first && a.second > b.second);
+    });
+    for (std::size_t i = 0; i < evicted.size(); i++) {
+        VertexId v = evicted[i].first;
+        if (i > 0 && evicted[i-1].first == v) continue;
+        int oldDeg = evicted[i].second, newDeg = degMap[v];
+        if (newDeg == 0) dropped.push_back(std::make_pair(oldDeg,v));
+        else rekeyed.push_back(std::make_pair(std::make_pair(oldDeg,v), std::make_pair(newDeg,v)));
+    }
+    // the ones that left the graph go all at once
+    std::sort(dropped.begin(), dropped.end());
+    if (backend == MedianBackend::BTree) applyBatch(medTree, dropped, rekeyed);
+    else applyBatch(medMap, dropped, rekeyed);
+    evicted.clear();
+    dropped.clear();
+    rekeyed.clear();
 }
 
 // evict old transactions
-void MedianDegreeStruct::evictOldTransactions(const Transaction &t)
+void MedianDegreeStruct::evictOldTransactions(time_t now)
 {
     // remove everything outside the window
-    auto earliest = transactions.begin();
-    for ( ; earliest != transactions.end() && dateDiff(t,*earliest) >= 60.0; earliest++) {
-        std::string actor = earliest->second.first;
-        std::string target = earliest->second.second;
+    transactions.evictThrough(now - window, [this](EdgeKey edge, time_t when) {
+        // entries for edges that have been paid along again since are stale; skip them
+        time_t *edgeTime = graph.find(edge);
+        if (!edgeTime || *edgeTime != when) return false;
         
         // remove it from the graph
-        graph.erase(earliest->second);
+        graph.erase(edge);
+        degreeChanges++;
         
-        // decrement their degrees
+        // decrement their degrees; a vertex that drops to zero leaves the median tree
+        VertexId actor = firstVertex(edge);
+        VertexId target = secondVertex(edge);
         int da = degMap[actor]--;
         int dt = degMap[target]--;
-        
-        // remove them from the median tree
-        medMap.remove(std::make_pair(da,actor));
-        medMap.remove(std::make_pair(dt,target));
-        
-        // insert new values into the median tree [disallow zero]
-        
-        if (da-1>0) medMap.insert(std::make_pair(da-1,actor), /*unused*/ 0);
-        else degMap.erase(actor); // remove it from the degree map entirely
-                
-        if (dt-1>0) medMap.insert(std::make_pair(dt-1,target), /*unused*/ 0);
-        else degMap.erase(target); // remove it from the degree map entirely
+        if (backend == MedianBackend::Histogram) {
+            medHist.change(da, da-1);
+            medHist.change(dt, dt-1);
+            if (topTracked) {
+                topBuckets.change(actor, da, da-1);
+                topBuckets.change(target, dt, dt-1);
+            }
+        } else { // the tree is updated once per vertex, below
+            evicted.push_back(std::make_pair(actor, da));
+            evicted.push_back(std::make_pair(target, dt));
+        }
+        return true;
+    });
+    if (!evicted.empty()) applyEvictions();
+}
+
+
+int MedianDegreeStruct::vertexCount() const
+{
+    switch (backend) {
+        case MedianBackend::Histogram: return medHist.size();
+        case MedianBackend::BTree: return medTree.size();
+        default: return medMap.size();
+    }
+}
+
+void MedianDegreeStruct::degreesAt(const std::vector<int> &ranks, std::vector<int> &degrees) const
+{
+    if (backend == MedianBackend::Histogram) {
+        medHist.select(ranks, degrees);
+        return;
     }
-    // actually remove all the earliest entries (earliest)
-    transactions.erase(transactions.begin(),earliest);
+    statKeys.clear();
+    if (backend == MedianBackend::BTree) medTree.select(ranks, statKeys);
+    else medMap.select(ranks, statKeys);
+    degrees.resize(statKeys.size());
+    for (std::size_t i = 0; i < statKeys.size(); i++) degrees[i] = statKeys[i].first;
 }
 
+void MedianDegreeStruct::getTopDegrees(std::size_t k, std::vector<DegName> &top) const
+{
+    switch (backend) {
+        case MedianBackend::Histogram:
+            if (!topTracked) throw std::logic_error("getTopDegrees() without trackTopDegrees()");
+            topBuckets.top(k, top);
+            break;
+        case MedianBackend::BTree: topOf(medTree, k, statRanks, top); break;
+        default: topOf(medMap, k, statRanks, top); break;
+    }
+}
+
+void MedianDegreeStruct::trackTopDegrees()
+{
+    if (topTracked || backend != MedianBackend::Histogram) return;
+    // whoever is in the graph already
+    for (std::size_t v = 0; v < degMap.size(); v++)
+        for (int d = 0; d < degMap[v]; d++) topBuckets.change(static_cast<VertexId>(v), d, d + 1);
+    topTracked = true;
+}
+
+void MedianDegreeStruct::getDegreeQuantiles(const std::vector<double> &quantiles, std::vector<double> &values) const
+{
+    values.assign(quantiles.size(), 0.0/0.0); // NaN
+    int n = vertexCount();
+    if (n <= 0) return;
+    
+    // each quantile falls on a rank, or between two neighbouring ones
+    statRanks.clear();
+    for (double q : quantiles) {
+        double pos = std::min(std::max(q, 0.0), 1.0) * (n - 1);
+        statRanks.push_back(static_cast<int>(std::floor(pos)));
+        statRanks.push_back(static_cast<int>(std::ceil(pos)));
+    }
+    std::sort(statRanks.begin(), statRanks.end());
+    statRanks.erase(std::unique(statRanks.begin(), statRanks.end()), statRanks.end());
+    degreesAt(statRanks, statDegrees);
+    
+    auto degreeAt = [this](int rank) {
+        return statDegrees[std::lower_bound(statRanks.begin(), statRanks.end(), rank) - statRanks.begin()];
+    };
+    for (std::size_t i = 0; i < quantiles.size(); i++) {
+        double pos = std::min(std::max(quantiles[i], 0.0), 1.0) * (n - 1);
+        int lo = static_cast<int>(std::floor(pos)), hi = static_cast<int>(std::ceil(pos));
+        int dlo = degreeAt(lo), dhi = degreeAt(hi);
+        values[i] = dlo + (pos - lo) * (dhi - dlo);
+    }
+}
 
 double MedianDegreeStruct::getMedianDegree() const
 {
+    if (backend == MedianBackend::Histogram) return medHist.median();
+    if (backend == MedianBackend::BTree) return medianOf(medTree);
+    
     int n = medMap.size();
     if (n <= 0) return 0.0/0.0; // NaN
     if (n % 2) { // odd size
-        return medMap.orderStatistic(n/2).first.first; // truncates
+        return medMap.select(n/2)->first; // truncates
     } else {
-        return 0.5 * (medMap.orderStatistic(n/2 - 1).first.first + medMap.orderStatistic(n/2).first.first);
+        // the upper middle is usually right below the lower one, so step to it
+        auto lower = medMap.select(n/2 - 1);
+        int lowerDeg = lower->first;
+        return 0.5 * (lowerDeg + (++lower)->first);
     }
 }
\ No newline at end of file
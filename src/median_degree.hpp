@@ -1,68 +1,149 @@
+#ifndef median_degree_hpp
+#define median_degree_hpp
+
 #include <iostream>
-#include <unordered_map>
-#include <map>
-#include <set>
+#include <cstdint>
+#include <limits>
 #include <string>
-#include <chrono>
 #include <utility>
-#include <time.h> // POSIX version required
-#include "json.hpp"
+#include <vector>
+#include <time.h>
+#include "counted_btree.hpp"
+#include "degree_buckets.hpp"
+#include "degree_histogram.hpp"
+#include "flat_edge_map.hpp"
+#include "name_table.hpp"
+#include "record_status.hpp"
+#include "transaction_ring.hpp"
 #include "treap.hpp"
 
 class Random {
     int val;
 public:
     Random() : val(std::rand()) {}
-    bool operator<(Random rhs) { return val < rhs.val;}
+    bool operator<(Random rhs) const { return val < rhs.val;}
 };
 
-class EmptyActorException {};
+
+// how the median of the degrees is kept up to date
+enum class MedianBackend {
+    Treap,     // order-statistics tree of (degree, vertex); O(log n)
+    BTree,     // the same, as a B+tree of cache-line-sized nodes with counts; O(log n), fewer misses
+    Histogram  // count of vertices per degree, with a cursor on the median; O(1)
+};
 
 
 class MedianDegreeStruct {
 public:
+    // One window's graph. Records come in already decoded and interned (WindowedMedians does
+    //   that, once for all the windows), with times as integer ticks of whatever resolution.
+    //   The graph covers the transactions less than window ticks older than the latest one;
+    //   one that arrives more than maxLateness ticks behind the latest is ignored as well.
+    explicit MedianDegreeStruct(MedianBackend backend = MedianBackend::Histogram, time_t window = 60,
+                                time_t maxLateness = std::numeric_limits<time_t>::max())
+    : window(window), maxLateness(maxLateness),
+      transactions(window), backend(backend), degreeChanges(0), topTracked(false) {}
+    
     // GRAPH DATA
     
-    // A transaction is basically our native JSON format.
-    //  The second pair will always be in increasing lexicographic order,
-    //    since we do not distinguish direction of payments.
-    //  The first item is the date, which is converted to system time from the JSON.
-    //    REQUIRES: POSIX standard time.h; the ISO standard version is problematic
-    using Transaction = std::pair<time_t,std::pair<std::string,std::string>>;
+    // Vertices are people, known by the id their name was interned under; names are
+    //   looked up (and copied) once per event, and only ever turned back into strings
+    //   for diagnostics.
+    using VertexId = NameTable::Id;
+    // An edge is a pair of vertices packed into one integer, the smaller id in the high
+    //   half, since we do not distinguish direction of payments.
+    using EdgeKey = std::uint64_t;
+    static EdgeKey edgeKey(VertexId a, VertexId b)
+    { return a < b ? (EdgeKey(a) << 32 | b) : (EdgeKey(b) << 32 | a); }
+    static VertexId firstVertex(EdgeKey e) { return static_cast<VertexId>(e >> 32); }
+    static VertexId secondVertex(EdgeKey e) { return static_cast<VertexId>(e); }
     
-    // TransactionList is ordered first by time, then transaction participants
-    //   The reason why we need this ordering is for efficient min and max;
-    //     we want this in order to be able to maintain the window between
-    //     earliest and latest transactions.
-    using TransactionList = std::set<Transaction>;
+    // A transaction is basically our native JSON format: the date, converted to UNIX
+    //   time (in ticks) from the JSON, and the edge between the two participants.
+    // TransactionList keeps them bucketed by time; all we need of it is the earliest
+    //   and latest transactions, in order to maintain the window between them.
+    using TransactionList = TransactionRing;
     
     // This is the actual graph; it is stored as map of edges, rather than the traditional
     //   vertices with adjacency list, because for our purposes, we need to be able to find
     //   specific edges quickly. A more traditional structure favors things like DFS and BFS.
-    using EdgeMap = std::map<std::pair<std::string,std::string>,time_t>;
+    //   Every event looks up an edge, so this is a flat hash table rather than a tree.
+    using EdgeMap = FlatEdgeMap;
     
     
     // MEDIAN DATA
     
     // this will be the key for the median updates tree. It is ordered lexicographically.
-    using DegName = std::pair<int, std::string>;
+    using DegName = std::pair<int, VertexId>;
     // this is required for us to store and look up degrees. In essence,
-    //   it's how we store the vertices of the graph
-    using DegreeMap = std::unordered_map<std::string,int>;
+    //   it's how we store the vertices of the graph; ids are dense, so it's indexed by id
+    //   (vertices outside the window have degree zero)
+    using DegreeMap = std::vector<int>;
     // The actual median updates tree. It is implemented as an augmented treap, using
     //   dynamic order statistics. It is cleaner than augmenting a traditional red-black tree
     using MedianMap = Treap<DegName,int,Random>;
+    // The same, as a B+tree: a few cache lines per level instead of one node per binary
+    //   decision, which matters once there are too many vertices to stay in cache
+    using MedianBTree = CountedBTree<DegName,int>;
+    // The alternative: degrees only ever change by one, so just count them
+    using MedianHistogram = DegreeHistogram;
+    // which has no idea who is who; for the highest degrees, it takes the vertices by degree
+    using TopBuckets = DegreeBuckets;
     
-    // actual insertion function
-    void insert(const nlohmann::json& j);
+    // actual insertion function, for participants interned by WindowedMedians; anything but
+    //   RecordStatus::Ok means the record was skipped
+    RecordStatus insert(time_t transactionTime, VertexId actor, VertexId target);
     double getMedianDegree() const;
+    // More of the degree distribution: the degree at each of the given quantiles (each in
+    //   [0, 1]: 0.5 is the median, 1 the maximum), interpolated between neighbouring ranks
+    //   the way the median is. All the ranks needed are looked up in one pass; NaN when empty.
+    void getDegreeQuantiles(const std::vector<double> &quantiles, std::vector<double> &values) const;
+    // goes up whenever an edge comes or goes; as long as it stays put, so do the median
+    //   and quantiles, and there is no need to look them up again
+    std::uint64_t version() const { return degreeChanges; }
+    
+    // The k highest-degree vertices, highest first, as (degree, vertex); fewer if there
+    //   aren't k. Among equal degrees the lower id (the name seen first) comes first,
+    //   whatever the backend. The trees have them at their top end; the histogram needs
+    //   trackTopDegrees() to have been called, to keep its vertices by degree on the side,
+    //   and throws std::logic_error otherwise. O(k log k) or so, whatever the graph size.
+    void getTopDegrees(std::size_t k, std::vector<DegName> &top) const;
+    // start keeping the histogram's vertices by degree (from whatever is in the graph now);
+    //   nothing to do for the trees
+    void trackTopDegrees();
 private:
     // could make this public, if, say, we start to synchronize this data structure with actual
     // ticking clocks, with a live stream
-    void evictOldTransactions(const Transaction &t);
+    void evictOldTransactions(time_t now);
+    // move a vertex's entry in the median tree from its old degree to its new one
+    void changeDegree(VertexId v, int oldDeg, int newDeg);
+    // move the vertices that lost edges in an eviction to their new degrees in the median tree
+    void applyEvictions();
+    // how many vertices the median is over, i.e., those of nonzero degree
+    int vertexCount() const;
+    // the degrees at several ranks (sorted), from whichever structure is in use
+    void degreesAt(const std::vector<int> &ranks, std::vector<int> &degrees) const;
+    
+    time_t window, maxLateness;
     
     TransactionList transactions;
     EdgeMap graph;
     DegreeMap degMap;
+    MedianBackend backend;
     MedianMap medMap;
+    MedianBTree medTree;
+    MedianHistogram medHist;
+    TopBuckets topBuckets; // only with the histogram, and only if asked for
+    std::uint64_t degreeChanges;
+    bool topTracked;
+    
+    // scratch space for applyEvictions(), kept to reuse its memory
+    std::vector<std::pair<VertexId,int>> evicted; // (vertex, degree before losing the edge)
+    std::vector<DegName> dropped;
+    std::vector<std::pair<DegName,DegName>> rekeyed;
+    // and for getDegreeQuantiles()
+    mutable std::vector<int> statRanks, statDegrees;
+    mutable std::vector<DegName> statKeys;
 };
+
+#endif /* median_degree_hpp */
@@ -0,0 +1,160 @@
+#include "median_writer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h> // POSIX
+
+namespace {
+    // room for any value we might format, including its terminator
+    const std::size_t maxField = 32;
+}
+
+MedianWriter::MedianWriter(const char *path, std::size_t bufferSize)
+: fd(-1), ownsFd(false), buffer(bufferSize < maxField ? maxField : bufferSize), used(0),
+  spare(buffer.size()), spareUsed(0), pending(false), stopping(false)
+{
+    if (path) fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) ownsFd = true;
+    else fd = STDOUT_FILENO; // write to stdout if file is invalid
+
+    ioThread = std::thread(&MedianWriter::ioLoop, this);
+}
+
+MedianWriter::~MedianWriter()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        stopping = true;
+    }
+    ioCv.notify_all();
+    ioThread.join(); // drains whatever is still pending
+    if (ownsFd) close(fd);
+}
+
+void MedianWriter::waitForSpare()
+{
+    std::unique_lock<std::mutex> lock(ioMutex);
+    ioCv.wait(lock, [this] { return !pending; });
+}
+
+void MedianWriter::flush()
+{
+    waitForSpare();
+    if (used == 0) return;
+
+    // swap buffers: the full one goes out, the drained one gets filled
+    buffer.swap(spare);
+    spareUsed = used;
+    used = 0;
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        pending = true;
+    }
+    ioCv.notify_all();
+}
+
+void MedianWriter::ioLoop()
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(ioMutex);
+            ioCv.wait(lock, [this] { return pending || stopping; });
+            if (!pending) return; // stopping, and nothing left to write
+        }
+
+        const char *p = spare.data();
+        std::size_t left = spareUsed;
+        while (left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break; // nowhere to report it; same as a failed ostream
+            }
+            p += n;
+            left -= n;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(ioMutex);
+            pending = false;
+        }
+        ioCv.notify_all();
+    }
+}
+
+void MedianWriter::writeMedian(double median)
+{
+    reserve(maxField);
+    putFixed(median);
+    buffer[used++] = '\n';
+}
+
+void MedianWriter::writeRow(const std::vector<double> &values, StringRef tail)
+{
+    reserve(values.size() * (maxField + 1) + tail.size + 1);
+    for (std::size_t i = 0; i < values.size(); i++) {
+        if (i > 0) buffer[used++] = ' ';
+        putFixed(values[i]);
+    }
+    putTail(tail);
+}
+
+void MedianWriter::writeRow(std::uint64_t index, const std::vector<double> &values, StringRef tail)
+{
+    reserve((values.size() + 1) * (maxField + 1) + tail.size + 1);
+    used = putDigits(buffer.data() + used, index) - buffer.data();
+    for (double v : values) {
+        buffer[used++] = ' ';
+        putFixed(v);
+    }
+    putTail(tail);
+}
+
+// the end of a line; there is room, as reserved by the caller
+void MedianWriter::putTail(StringRef tail)
+{
+    if (tail.size) std::memcpy(buffer.data() + used, tail.data, tail.size);
+    used += tail.size;
+    buffer[used++] = '\n';
+}
+
+char *MedianWriter::putDigits(char *out, std::uint64_t v)
+{
+    // written backwards into a scratch area and then copied out
+    char digits[20];
+    int nd = 0;
+    do {
+        digits[nd++] = char('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (nd) *out++ = digits[--nd];
+    return out;
+}
+
+void MedianWriter::putFixed(double v)
+{
+    char *out = buffer.data() + used;
+    double twice = 2 * v;
+    // anything that isn't a (reasonably sized) multiple of one half gets the slow path
+    if (!(std::fabs(twice) < 1e15) || twice != std::floor(twice)) {
+        // snprintf returns the length it wanted; anything past the field was cut off
+        int n = std::snprintf(out, maxField, "%.2f", v);
+        if (n > 0) used += std::min(static_cast<std::size_t>(n), maxField - 1);
+        return;
+    }
+
+    long long h = static_cast<long long>(twice);
+    if (h < 0) {
+        *out++ = '-';
+        h = -h;
+    }
+    out = putDigits(out, static_cast<std::uint64_t>(h / 2));
+    *out++ = '.';
+    *out++ = (h & 1) ? '5' : '0';
+    *out++ = '0';
+    used = out - buffer.data();
+}
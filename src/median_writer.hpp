@@ -0,0 +1,70 @@
+#ifndef median_writer_hpp
+#define median_writer_hpp
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "string_ref.hpp"
+
+// Output stage for the rolling medians.
+//   A median of degrees is always an integer or a half-integer, so it can be printed
+//   with two decimals exactly using integer arithmetic alone, rather than going through
+//   iostream locales and floating-point formatting for every line. Lines are collected
+//   in one large reusable buffer, which goes out with a single write() when full.
+//   The write itself happens on an I/O thread, so that the next buffer is being
+//   filled while the previous one drains.
+class MedianWriter {
+public:
+    // a null path, or one that cannot be opened, writes to stdout instead
+    explicit MedianWriter(const char *path, std::size_t bufferSize = 1 << 16);
+    ~MedianWriter(); // flushes
+
+    MedianWriter(const MedianWriter&) = delete;
+    MedianWriter& operator=(const MedianWriter&) = delete;
+
+    // one median per line, formatted like std::fixed with precision 2 ("nan" when empty)
+    void writeMedian(double median);
+    // several values on one line, separated by spaces, each formatted the same way,
+    //   followed by whatever text is given (as is)
+    void writeRow(const std::vector<double> &values, StringRef tail = StringRef());
+    // the same, after a leading integer (say, which record the values are as of)
+    void writeRow(std::uint64_t index, const std::vector<double> &values, StringRef tail = StringRef());
+
+    // hand the buffered lines to the I/O thread; they are written by the time the
+    //   next flush (or the destructor) returns
+    void flush();
+private:
+    // make sure at least n more bytes fit in the buffer
+    void reserve(std::size_t n)
+    {
+        if (buffer.size() - used < n) flush();
+        if (buffer.size() < n) buffer.resize(n); // a very long line; it's ours after flush()
+    }
+    void putFixed(double v);
+    void putTail(StringRef tail);
+    // the decimal digits of v at out; returns the end of them
+    static char *putDigits(char *out, std::uint64_t v);
+    void ioLoop();
+    // wait for the I/O thread to be done with the spare buffer
+    void waitForSpare();
+
+    int fd;
+    bool ownsFd;
+    std::vector<char> buffer;
+    std::size_t used;
+
+    // the buffer being written out; only the I/O thread touches it while pending
+    std::vector<char> spare;
+    std::size_t spareUsed;
+
+    // I/O thread state, guarded by ioMutex
+    std::thread ioThread;
+    std::mutex ioMutex;
+    std::condition_variable ioCv;
+    bool pending, stopping;
+};
+
+#endif /* median_writer_hpp */
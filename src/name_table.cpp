@@ -0,0 +1,66 @@
+#include "name_table.hpp"
+
+namespace {
+    const std::size_t initialSlots = 1 << 10;
+}
+
+const NameTable::Id NameTable::none;
+
+NameTable::NameTable()
+: slots(initialSlots, none), offsets(1, 0)
+{}
+
+std::uint32_t NameTable::hash(StringRef s)
+{
+    // FNV-1a; names are short, so this beats anything fancier
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < s.size; i++) {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+std::size_t NameTable::probe(StringRef name, std::uint32_t h) const
+{
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = h & mask; ; i = (i + 1) & mask) {
+        Id id = slots[i];
+        if (id == none || (hashes[id] == h && this->name(id) == name)) return i;
+    }
+}
+
+bool NameTable::find(StringRef name, Id &id) const
+{
+    std::size_t i = probe(name, hash(name));
+    if (slots[i] == none) return false;
+    id = slots[i];
+    return true;
+}
+
+NameTable::Id NameTable::intern(StringRef name)
+{
+    std::uint32_t h = hash(name);
+    std::size_t i = probe(name, h);
+    if (slots[i] != none) return slots[i];
+
+    Id id = static_cast<Id>(hashes.size());
+    hashes.push_back(h);
+    bytes.append(name.data, name.size);
+    offsets.push_back(bytes.size());
+    slots[i] = id;
+    if (2 * hashes.size() > slots.size()) grow();
+    return id;
+}
+
+void NameTable::grow()
+{
+    std::vector<Id> bigger(2 * slots.size(), none);
+    const std::size_t mask = bigger.size() - 1;
+    for (Id id = 0; id < hashes.size(); id++) {
+        std::size_t i = hashes[id] & mask;
+        while (bigger[i] != none) i = (i + 1) & mask;
+        bigger[i] = id;
+    }
+    slots.swap(bigger);
+}
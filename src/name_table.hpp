@@ -0,0 +1,45 @@
+#ifndef name_table_hpp
+#define name_table_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "string_ref.hpp"
+
+// Interning table: hands out a dense 32-bit id for each distinct name, the first time
+//   it shows up, so that everything downstream can be keyed on small integers instead of
+//   copying and comparing strings. The names themselves are packed end to end in one
+//   buffer, and found again through an open-addressing table of ids, so looking up a
+//   name that is already known allocates nothing.
+class NameTable {
+public:
+    using Id = std::uint32_t;
+
+    NameTable();
+
+    // the id of name, adding it if it's new
+    Id intern(StringRef name);
+    // the id of name, or false if it has never been interned
+    bool find(StringRef name, Id &id) const;
+
+    // only valid until the next intern() (the buffer may move)
+    StringRef name(Id id) const
+    { return StringRef(bytes.data() + offsets[id], offsets[id + 1] - offsets[id]); }
+
+    std::size_t size() const { return hashes.size(); }
+private:
+    static const Id none = ~Id(0);
+
+    static std::uint32_t hash(StringRef s);
+    // the slot holding name, or the empty slot where it would go
+    std::size_t probe(StringRef name, std::uint32_t h) const;
+    void grow();
+
+    std::vector<Id> slots;           // power-of-two size, never more than half full
+    std::vector<std::uint32_t> hashes; // by id, so growing doesn't rehash the names
+    std::vector<std::size_t> offsets;  // name i is bytes[offsets[i], offsets[i+1])
+    std::string bytes;
+};
+
+#endif /* name_table_hpp */
@@ -0,0 +1,130 @@
+#include "parallel_parser.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "structural_scan.hpp"
+#include "timestamp.hpp"
+#include "venmo_parser.hpp"
+
+namespace {
+    // how many chunks the workers may run ahead of the applier, per worker
+    const std::size_t chunksAheadPerThread = 4;
+}
+
+ParallelParser::ParallelParser(StringRef input, unsigned threads, unsigned ticksPerSecond, std::size_t chunkSize)
+: threads(threads ? threads : 1), ticksPerSecond(ticksPerSecond)
+{
+    // cut into roughly equal pieces, each extended to the end of the line it stops in
+    const char *p = input.begin(), *e = input.end();
+    while (p < e) {
+        const char *cut = std::size_t(e - p) > chunkSize ? p + chunkSize : e;
+        if (cut < e) {
+            const char *nl = static_cast<const char*>(std::memchr(cut, '\n', e - cut));
+            cut = nl ? nl + 1 : e;
+        }
+        chunks.emplace_back();
+        chunks.back().bytes = StringRef(p, cut);
+        chunks.back().ready = false;
+        p = cut;
+    }
+}
+
+void ParallelParser::parseChunk(Chunk &c)
+{
+    // every worker gets its own scanner, parser and decoder (they all carry state)
+    StructuralScanner scanner;
+    VenmoParser parser;
+    TimestampDecoder decoder(ticksPerSecond);
+    RecordIndex idx;
+
+    // views into the parser's own storage don't outlive the next parse: keep a copy
+    auto keep = [&c](StringRef s) {
+        if (s.begin() >= c.bytes.begin() && s.end() <= c.bytes.end()) return s;
+        c.spill.push_back(s.str());
+        return StringRef(c.spill.back().data(), c.spill.back().size());
+    };
+
+    c.transactions.reserve(c.bytes.size / 64);
+    const char *p = c.bytes.begin(), *e = c.bytes.end();
+    while (p < e) {
+        const char *nl = scanner.scanRecord(p, e, idx);
+        StringRef line(p, nl);
+        p = nl < e ? nl + 1 : e;
+        if (!line.empty() && line[line.size - 1] == '\r') line.size--; // DOS line endings
+        if (line.empty()) continue;
+
+        VenmoRecord r;
+        ParsedTransaction t;
+        t.status = parser.parse(line, idx, r);
+        if (t.status == RecordStatus::Ok) {
+            if (!decoder.decode(r.createdTime, t.time)) t.status = RecordStatus::BadTimestamp;
+            t.actor = keep(r.actor);
+            t.target = keep(r.target);
+        }
+        c.transactions.push_back(t);
+    }
+}
+
+void ParallelParser::run(const ApplyFn &apply)
+{
+    std::mutex mtx;
+    std::condition_variable parsedCv, appliedCv;
+    std::size_t nextToParse = 0, applied = 0; // guarded by mtx
+    bool stop = false;
+    const std::size_t maxAhead = threads * chunksAheadPerThread;
+
+    auto worker = [&]() {
+        while (true) {
+            std::size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                appliedCv.wait(lock, [&] { return stop || nextToParse >= chunks.size() || nextToParse < applied + maxAhead; });
+                if (stop || nextToParse >= chunks.size()) return;
+                i = nextToParse++;
+            }
+            parseChunk(chunks[i]);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                chunks[i].ready = true;
+            }
+            parsedCv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned k = 0; k < threads; k++) pool.emplace_back(worker);
+
+    // apply in order on this thread; the workers must be joined before anything escapes
+    std::exception_ptr error;
+    try {
+        for (std::size_t i = 0; i < chunks.size(); i++) {
+            Chunk &c = chunks[i];
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                parsedCv.wait(lock, [&] { return c.ready; });
+            }
+            for (const ParsedTransaction &t : c.transactions) apply(t);
+
+            // done with this chunk: free it, and let the workers move on
+            std::vector<ParsedTransaction>().swap(c.transactions);
+            c.spill.clear();
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                applied = i + 1;
+            }
+            appliedCv.notify_all();
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    appliedCv.notify_all();
+    for (std::thread &th : pool) th.join();
+
+    if (error) std::rethrow_exception(error);
+}
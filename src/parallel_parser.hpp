@@ -0,0 +1,57 @@
+#ifndef parallel_parser_hpp
+#define parallel_parser_hpp
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+#include <time.h>
+#include "record_status.hpp"
+#include "string_ref.hpp"
+
+// A payment that has been parsed and had its timestamp decoded, ready to be applied
+//   to the graph. The names are views into the input (or into the chunk's own storage
+//   for the odd record that needed the full JSON parser).
+struct ParsedTransaction {
+    time_t time;
+    StringRef actor;
+    StringRef target;
+    RecordStatus status; // anything but Ok: the record is to be skipped, and the rest is meaningless
+};
+
+// Parsing is embarrassingly parallel, but graph updates must happen in input order.
+//   The (memory-mapped) input is cut into chunks on line boundaries, which a pool of
+//   worker threads parse and timestamp-decode into compact arrays of transactions;
+//   the calling thread then applies them strictly in order. Only a limited number of
+//   chunks is ever parsed ahead of the applier, to keep memory bounded.
+class ParallelParser {
+public:
+    using ApplyFn = std::function<void(const ParsedTransaction&)>;
+
+    // input must stay valid (and unchanged) until run() returns; times are decoded
+    //   to ticksPerSecond, as by TimestampDecoder
+    ParallelParser(StringRef input, unsigned threads, unsigned ticksPerSecond = 1,
+                   std::size_t chunkSize = 1 << 20);
+
+    // Calls apply for every non-blank record (skipped ones included), in input order,
+    //   on the calling thread. Anything apply throws is rethrown here, once the workers
+    //   have stopped.
+    void run(const ApplyFn &apply);
+private:
+    struct Chunk {
+        StringRef bytes;
+        std::vector<ParsedTransaction> transactions;
+        std::deque<std::string> spill; // owned copies of names the fast path couldn't view in place
+        bool ready;
+    };
+
+    void parseChunk(Chunk &c);
+
+    std::vector<Chunk> chunks;
+    unsigned threads;
+    unsigned ticksPerSecond;
+};
+
+#endif /* parallel_parser_hpp */
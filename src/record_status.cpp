@@ -0,0 +1,35 @@
+#include "record_status.hpp"
+#include <ostream>
+
+namespace {
+    const char *describe(RecordStatus s)
+    {
+        switch (s) {
+            case RecordStatus::BadJson: return "malformed JSON";
+            case RecordStatus::MissingField: return "missing or non-string field";
+            case RecordStatus::BadTimestamp: return "malformed timestamp";
+            case RecordStatus::EmptyActor: return "empty actor";
+            case RecordStatus::EmptyTarget: return "empty target";
+            case RecordStatus::SelfPayment: return "self-payment";
+            default: return "ok";
+        }
+    }
+}
+
+std::uint64_t SkipCounts::total() const
+{
+    std::uint64_t n = 0;
+    for (int i = static_cast<int>(RecordStatus::Ok) + 1; i < static_cast<int>(RecordStatus::NumStatuses); i++)
+        n += counts[i];
+    return n;
+}
+
+void SkipCounts::report(std::ostream &os) const
+{
+    if (total() == 0) return;
+    os << "Skipped " << total() << " bad record(s):\n";
+    for (int i = static_cast<int>(RecordStatus::Ok) + 1; i < static_cast<int>(RecordStatus::NumStatuses); i++) {
+        if (counts[i]) os << "  " << counts[i] << ' ' << describe(static_cast<RecordStatus>(i)) << '\n';
+    }
+    os.flush();
+}
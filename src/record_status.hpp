@@ -0,0 +1,36 @@
+#ifndef record_status_hpp
+#define record_status_hpp
+
+#include <cstdint>
+#include <iosfwd>
+
+// What became of one input record. Anything but Ok means the record was skipped;
+//   bad records are common enough on dirty feeds (and come in bursts) that they are
+//   reported by status code rather than by throwing.
+enum class RecordStatus {
+    Ok,
+    BadJson,       // not valid JSON at all
+    MissingField,  // created_time, actor or target missing, or not a string
+    BadTimestamp,
+    EmptyActor,
+    EmptyTarget,
+    SelfPayment,   // actor and target are the same person
+    NumStatuses
+};
+
+// how many records were skipped, and why
+class SkipCounts {
+public:
+    SkipCounts() : counts() {}
+
+    void add(RecordStatus s) { counts[static_cast<int>(s)]++; }
+    std::uint64_t operator[](RecordStatus s) const { return counts[static_cast<int>(s)]; }
+    std::uint64_t total() const;
+
+    // one summary line per reason that actually came up; nothing if nothing was skipped
+    void report(std::ostream &os) const;
+private:
+    std::uint64_t counts[static_cast<int>(RecordStatus::NumStatuses)];
+};
+
+#endif /* record_status_hpp */
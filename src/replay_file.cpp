@@ -0,0 +1,165 @@
+#include "replay_file.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h> // POSIX
+
+namespace {
+    const char magic[8] = {'V','N','M','R','P','L','A','Y'};
+    const std::uint32_t version = 3;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t padding;
+    };
+
+    struct Trailer {
+        std::uint64_t records;
+        std::uint64_t names;
+        std::uint64_t dictionaryOffset;
+        char magic[8];
+    };
+
+    const std::size_t bufferSize = 1 << 16;
+}
+
+ReplayWriter::ReplayWriter(const char *path)
+: fd(-1), ownsFd(false), finished(false), buffer(bufferSize), used(0), written(0), records(0)
+{
+    if (path) fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) ownsFd = true;
+    else fd = STDOUT_FILENO; // write to stdout if file is invalid
+
+    Header h;
+    std::memcpy(h.magic, magic, sizeof magic);
+    h.version = version;
+    h.padding = 0;
+    put(&h, sizeof h);
+}
+
+ReplayWriter::~ReplayWriter()
+{
+    finish();
+    if (ownsFd) close(fd);
+}
+
+void ReplayWriter::add(time_t time, StringRef actor, StringRef target)
+{
+    ReplayRecord r;
+    r.time = time;
+    r.actor = names.intern(actor);
+    r.target = names.intern(target);
+    put(&r, sizeof r);
+    records++;
+}
+
+void ReplayWriter::addSkipped(RecordStatus why)
+{
+    ReplayRecord r;
+    r.time = ReplayRecord::skipped;
+    r.actor = static_cast<std::uint32_t>(why);
+    r.target = 0;
+    put(&r, sizeof r);
+    records++;
+}
+
+void ReplayWriter::finish()
+{
+    if (finished) return;
+    finished = true;
+
+    Trailer t;
+    t.records = records;
+    t.names = names.size();
+    t.dictionaryOffset = written;
+    std::memcpy(t.magic, magic, sizeof magic);
+
+    for (NameTable::Id id = 0; id < names.size(); id++) {
+        StringRef name = names.name(id);
+        std::uint32_t len = static_cast<std::uint32_t>(name.size);
+        put(&len, sizeof len);
+        put(name.data, len);
+    }
+    put(&t, sizeof t);
+    flush();
+}
+
+void ReplayWriter::put(const void *p, std::size_t n)
+{
+    const char *src = static_cast<const char*>(p);
+    written += n;
+    while (n > 0) {
+        if (used == buffer.size()) flush();
+        std::size_t k = buffer.size() - used < n ? buffer.size() - used : n;
+        std::memcpy(buffer.data() + used, src, k);
+        used += k;
+        src += k;
+        n -= k;
+    }
+}
+
+void ReplayWriter::flush()
+{
+    const char *p = buffer.data();
+    std::size_t left = used;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // nowhere to report it; same as MedianWriter
+        }
+        p += n;
+        left -= n;
+    }
+    used = 0;
+}
+
+ReplayReader::ReplayReader(StringRef data)
+: records(nullptr), count(0), pos(0)
+{
+    Header h;
+    Trailer t;
+    if (data.size < sizeof h + sizeof t) throw BadReplayException();
+    std::memcpy(&h, data.begin(), sizeof h);
+    std::memcpy(&t, data.end() - sizeof t, sizeof t);
+    if (std::memcmp(h.magic, magic, sizeof magic) != 0 || h.version != version ||
+        std::memcmp(t.magic, magic, sizeof magic) != 0) throw BadReplayException();
+
+    // the records have to fit exactly between the header and the dictionary
+    const std::uint64_t dictEnd = data.size - sizeof t;
+    if (t.dictionaryOffset < sizeof h || t.dictionaryOffset > dictEnd ||
+        (t.dictionaryOffset - sizeof h) / sizeof(ReplayRecord) != t.records ||
+        (t.dictionaryOffset - sizeof h) % sizeof(ReplayRecord) != 0) throw BadReplayException();
+    records = reinterpret_cast<const ReplayRecord*>(data.begin() + sizeof h);
+    count = t.records;
+
+    // pick out the names; they stay where they are. Each takes at least its length
+    //   field, which bounds how many there can be before anything is allocated for them
+    if (t.names > (dictEnd - t.dictionaryOffset) / sizeof(std::uint32_t)) throw BadReplayException();
+    const char *p = data.begin() + t.dictionaryOffset, *e = data.begin() + dictEnd;
+    names.reserve(t.names);
+    for (std::uint64_t i = 0; i < t.names; i++) {
+        std::uint32_t len;
+        if (std::size_t(e - p) < sizeof len) throw BadReplayException();
+        std::memcpy(&len, p, sizeof len);
+        p += sizeof len;
+        if (std::size_t(e - p) < len) throw BadReplayException();
+        names.emplace_back(p, len);
+        p += len;
+    }
+    if (p != e) throw BadReplayException();
+}
+
+bool ReplayReader::next(ReplayRecord &r)
+{
+    if (pos == count) return false;
+    r = records[pos++];
+    if (r.time == ReplayRecord::skipped) {
+        if (r.actor == static_cast<std::uint32_t>(RecordStatus::Ok) ||
+            r.actor >= static_cast<std::uint32_t>(RecordStatus::NumStatuses)) throw BadReplayException();
+        return true;
+    }
+    if (r.actor >= names.size() || r.target >= names.size()) throw BadReplayException();
+    return true;
+}
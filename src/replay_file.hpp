@@ -0,0 +1,83 @@
+#ifndef replay_file_hpp
+#define replay_file_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <time.h>
+#include "name_table.hpp"
+#include "record_status.hpp"
+#include "string_ref.hpp"
+
+// Compact binary form of a Venmo dump, for replaying the same history many times
+//   without parsing any JSON. Everything is in native byte order:
+//     header:     8-byte magic, uint32 version, uint32 padding
+//     records:    one fixed-size ReplayRecord per input record, in input order, with times
+//                 in milliseconds (whatever resolution the replay is to run at)
+//     dictionary: for each name id in turn, a uint32 length followed by the name's bytes
+//     trailer:    uint64 record count, uint64 name count, uint64 dictionary offset, magic
+//   The trailer goes last so that the file can be written in one sequential pass
+//   (even into a pipe), with names interned as they show up.
+//   Records that would be skipped are kept (as time == skipped), so that a replay counts
+//   them just the same; all other records are between two different, non-empty names.
+struct ReplayRecord {
+    static const std::int64_t skipped = INT64_MIN; // actor holds the RecordStatus instead of a name
+    static const unsigned ticksPerSecond = 1000;
+
+    std::int64_t time;    // UNIX time, in milliseconds
+    std::uint32_t actor;  // name ids, i.e., indices into the dictionary
+    std::uint32_t target;
+};
+
+class BadReplayException {};
+
+// Builds a replay file from parsed records.
+class ReplayWriter {
+public:
+    // a null path, or one that cannot be opened, writes to stdout instead
+    explicit ReplayWriter(const char *path);
+    ~ReplayWriter(); // finishes the file, if that hasn't happened yet
+
+    ReplayWriter(const ReplayWriter&) = delete;
+    ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+    void add(time_t time, StringRef actor, StringRef target);
+    // a record that is to be skipped, for whatever reason
+    void addSkipped(RecordStatus why);
+
+    // writes out the dictionary and trailer; nothing may be added afterwards
+    void finish();
+private:
+    void put(const void *p, std::size_t n);
+    void flush();
+
+    int fd;
+    bool ownsFd, finished;
+    std::vector<char> buffer;
+    std::size_t used;
+    std::uint64_t written, records; // bytes so far, records so far
+
+    NameTable names;
+};
+
+// Reads a replay file in place. Names are views into the file's bytes.
+class ReplayReader {
+public:
+    // data is a whole replay file, and must outlive the reader;
+    //   throws BadReplayException if it doesn't look like one
+    explicit ReplayReader(StringRef data);
+
+    std::uint64_t size() const { return count; }
+    // the names, by id
+    const std::vector<StringRef> &dictionary() const { return names; }
+
+    // get the next record; returns false at the end.
+    //   Throws BadReplayException for a name id outside the dictionary.
+    bool next(ReplayRecord &r);
+private:
+    const ReplayRecord *records;
+    std::uint64_t count, pos;
+    std::vector<StringRef> names;
+};
+
+#endif /* replay_file_hpp */
@@ -0,0 +1,32 @@
+#ifndef string_ref_hpp
+#define string_ref_hpp
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// A non-owning view of a run of characters: a stand-in for std::string_view, which
+//   is not available in C++14. The viewed bytes belong to whoever produced the view
+//   (usually an InputReader), and are only valid as long as that owner says so.
+struct StringRef {
+    const char *data;
+    std::size_t size;
+
+    StringRef() : data(nullptr), size(0) {}
+    StringRef(const char *d, std::size_t n) : data(d), size(n) {}
+    StringRef(const char *b, const char *e) : data(b), size(e - b) {}
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + size; }
+    bool empty() const { return size == 0; }
+    char operator[](std::size_t i) const { return data[i]; }
+
+    // only make an owning copy when someone really needs one
+    std::string str() const { return std::string(data, size); }
+
+    bool operator==(StringRef rhs) const
+    { return size == rhs.size && (size == 0 || std::memcmp(data, rhs.data, size) == 0); }
+    bool operator!=(StringRef rhs) const { return !(*this == rhs); }
+};
+
+#endif /* string_ref_hpp */
@@ -0,0 +1,134 @@
+#include "structural_scan.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRUCTURAL_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    const std::size_t blockSize = 64;
+
+    void scanBlockScalar(const char *block, StructuralScanner::BlockMasks &m)
+    {
+        m.newline = m.quote = m.backslash = m.control = 0;
+        for (unsigned i = 0; i < blockSize; i++) {
+            unsigned char c = block[i];
+            std::uint64_t bit = std::uint64_t(1) << i;
+            if (c == '\n') m.newline |= bit;
+            if (c == '"') m.quote |= bit;
+            if (c == '\\') m.backslash |= bit;
+            if (c < 0x20) m.control |= bit;
+        }
+    }
+
+#ifdef STRUCTURAL_SCAN_X86
+    // SSE2 is part of x86-64, so this needs no target attribute there
+    __attribute__((target("sse2")))
+    void scanBlockSSE2(const char *block, StructuralScanner::BlockMasks &m)
+    {
+        const __m128i nl = _mm_set1_epi8('\n'), qt = _mm_set1_epi8('"');
+        const __m128i bs = _mm_set1_epi8('\\'), ctl = _mm_set1_epi8(0x1F);
+        m.newline = m.quote = m.backslash = m.control = 0;
+        for (unsigned i = 0; i < blockSize; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+            m.newline |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)))) << i;
+            m.quote |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, qt)))) << i;
+            m.backslash |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, bs)))) << i;
+            // unsigned c <= 0x1F exactly when max(c, 0x1F) == 0x1F
+            m.control |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl)))) << i;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void scanBlockAVX2(const char *block, StructuralScanner::BlockMasks &m)
+    {
+        const __m256i nl = _mm256_set1_epi8('\n'), qt = _mm256_set1_epi8('"');
+        const __m256i bs = _mm256_set1_epi8('\\'), ctl = _mm256_set1_epi8(0x1F);
+        m.newline = m.quote = m.backslash = m.control = 0;
+        for (unsigned i = 0; i < blockSize; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+            m.newline |= std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)))) << i;
+            m.quote |= std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, qt)))) << i;
+            m.backslash |= std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, bs)))) << i;
+            m.control |= std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, ctl), ctl)))) << i;
+        }
+    }
+#endif
+
+    inline unsigned lowestBit(std::uint64_t x) { return __builtin_ctzll(x); }
+    inline unsigned bitCount(std::uint64_t x) { return __builtin_popcountll(x); }
+}
+
+StructuralScanner::StructuralScanner(Isa isa)
+: scanBlock(scanBlockScalar), chosen(Scalar)
+{
+#ifdef STRUCTURAL_SCAN_X86
+    __builtin_cpu_init();
+    if ((isa == AVX2 || isa == Best) && __builtin_cpu_supports("avx2")) {
+        scanBlock = scanBlockAVX2;
+        chosen = AVX2;
+    } else if (isa != Scalar && __builtin_cpu_supports("sse2")) {
+        scanBlock = scanBlockSSE2;
+        chosen = SSE2;
+    }
+#else
+    (void)isa;
+#endif
+}
+
+const char *StructuralScanner::isaName(Isa isa)
+{
+    switch (isa) {
+        case Scalar: return "scalar";
+        case SSE2: return "sse2";
+        case AVX2: return "avx2";
+        default: return "best";
+    }
+}
+
+const char *StructuralScanner::scanRecord(const char *b, const char *e, RecordIndex &idx) const
+{
+    idx.numQuotes = 0;
+    idx.hasBackslash = false;
+    unsigned controls = 0;
+    BlockMasks m;
+    const char *p = b;
+
+    while (p < e) {
+        std::size_t n = e - p;
+        std::uint64_t valid = ~std::uint64_t(0);
+        if (n >= blockSize) {
+            scanBlock(p, m);
+        } else {
+            // never read past the end: the final partial block gets copied out first
+            char tail[blockSize];
+            std::memcpy(tail, p, n);
+            std::memset(tail + n, ' ', blockSize - n);
+            scanBlock(tail, m);
+            valid = (std::uint64_t(1) << n) - 1;
+        }
+
+        std::uint64_t nl = m.newline & valid;
+        std::uint64_t inRecord = nl ? (nl & -nl) - 1 : valid; // everything before the newline
+
+        for (std::uint64_t q = m.quote & inRecord; q; q &= q - 1) {
+            if (idx.numQuotes < RecordIndex::maxQuotes)
+                idx.quotes[idx.numQuotes] = static_cast<std::uint32_t>(p - b + lowestBit(q));
+            idx.numQuotes++;
+        }
+        idx.hasBackslash |= (m.backslash & inRecord) != 0;
+        controls += bitCount(m.control & inRecord);
+
+        if (nl) {
+            p += lowestBit(nl);
+            break;
+        }
+        p += n < blockSize ? n : blockSize;
+    }
+
+    // a DOS line ending isn't part of the record as far as the parser is concerned
+    if (p > b && p[-1] == '\r') controls--;
+    idx.hasControl = controls != 0;
+    return p;
+}
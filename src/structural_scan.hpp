@@ -0,0 +1,48 @@
+#ifndef structural_scan_hpp
+#define structural_scan_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include "string_ref.hpp"
+
+// Where the interesting characters of one record are, as offsets from its start.
+//   For a well-behaved Venmo record there are exactly twelve quotes: an opening and a
+//   closing one for each of the three keys and three values.
+struct RecordIndex {
+    static const int maxQuotes = 12;
+
+    std::uint32_t quotes[maxQuotes];
+    int numQuotes;      // may exceed maxQuotes; only the first maxQuotes are recorded
+    bool hasBackslash;  // escapes need the full parser
+    bool hasControl;    // so do control characters (tabs included), apart from a trailing '\r'
+};
+
+// Structural indexing pass over the raw input: finds the end of the next record together
+//   with its quotes, backslashes and control characters, 64 bytes at a time.
+//   The per-block classification is done with SSE2 or AVX2 where the CPU has them
+//   (picked at run time), and with plain loops elsewhere.
+class StructuralScanner {
+public:
+    enum Isa { Scalar, SSE2, AVX2, Best };
+
+    // bit i of each mask is set if byte i of the 64-byte block is of that class
+    struct BlockMasks {
+        std::uint64_t newline, quote, backslash, control;
+    };
+    using ScanBlockFn = void (*)(const char *block, BlockMasks &m);
+
+    // asking for an instruction set the CPU doesn't have gets the best one it does have
+    explicit StructuralScanner(Isa isa = Best);
+
+    // Scan [b, e) for the first newline. Returns a pointer to it (or e if there isn't one),
+    //   and fills idx for the bytes before it. Only ever reads within [b, e).
+    const char *scanRecord(const char *b, const char *e, RecordIndex &idx) const;
+
+    Isa isa() const { return chosen; }
+    static const char *isaName(Isa isa);
+private:
+    ScanBlockFn scanBlock;
+    Isa chosen;
+};
+
+#endif /* structural_scan_hpp */
@@ -0,0 +1,87 @@
+#include "timestamp.hpp"
+#include <cstring>
+
+namespace {
+    // value of the two decimal digits at p, or -1 if they aren't both digits
+    inline int twoDigits(const char *p)
+    {
+        unsigned a = p[0] - '0', b = p[1] - '0';
+        return (a < 10 && b < 10) ? int(a * 10 + b) : -1;
+    }
+
+    inline bool isLeap(long y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+
+    inline unsigned daysInMonth(long y, unsigned m)
+    {
+        static const unsigned char days[] = {31,28,31,30,31,30,31,31,30,31,30,31};
+        return (m == 2 && isLeap(y)) ? 29 : days[m-1];
+    }
+}
+
+// Howard Hinnant's days_from_civil: shift the year to start in March, so that the leap
+//   day falls at the very end, and count eras of 400 years
+long TimestampDecoder::daysFromCivil(long y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);            // [0, 399]
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;  // [0, 365]
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;           // [0, 146096]
+    return era * 146097 + static_cast<long>(doe) - 719468;
+}
+
+bool TimestampDecoder::decode(StringRef s, time_t &t)
+{
+    // layout: YYYY-MM-DDTHH:MM:SSZ, or YYYY-MM-DDTHH:MM:SS.fffZ (any number of digits)
+    //         0123456789012345678 9             0123456789012345678901 2
+    if (s.size < 20 || s.size > 30 || s[s.size - 1] != 'Z') return false;
+    const char *p = s.data;
+
+    // whatever part of the fraction the resolution calls for; the rest is dropped
+    time_t frac = 0;
+    if (s.size > 20) {
+        if (s[19] != '.' || s.size == 21) return false;
+        unsigned scale = 1;
+        for (std::size_t i = 20; i < s.size - 1; i++) {
+            unsigned d = s[i] - '0';
+            if (d >= 10) return false;
+            if (scale < ticksPerSecond) {
+                frac = frac * 10 + d;
+                scale *= 10;
+            }
+        }
+        frac *= ticksPerSecond / scale;
+    }
+
+    // the seconds are the only thing that changes from one event to the next, usually
+    if (s[16] != ':') return false;
+    int sec = twoDigits(p + 17);
+    if (sec < 0 || sec > 60) return false; // allow a leap second; it rolls over like timegm's
+
+    if (!cachedDay || std::memcmp(p, dayPrefix, sizeof dayPrefix) != 0) {
+        if (p[4] != '-' || p[7] != '-') return false;
+        int hi = twoDigits(p), lo = twoDigits(p + 2);
+        int mon = twoDigits(p + 5), day = twoDigits(p + 8);
+        if (hi < 0 || lo < 0 || mon < 1 || mon > 12) return false;
+        long year = hi * 100 + lo;
+        if (day < 1 || unsigned(day) > daysInMonth(year, mon)) return false;
+
+        dayStart = static_cast<time_t>(daysFromCivil(year, mon, day)) * 86400;
+        std::memcpy(dayPrefix, p, sizeof dayPrefix);
+        cachedDay = true;
+        cachedMinute = false; // the minute is relative to the day
+    }
+
+    if (!cachedMinute || std::memcmp(p + 10, minutePrefix, sizeof minutePrefix) != 0) {
+        if (p[10] != 'T' || p[13] != ':') return false;
+        int hour = twoDigits(p + 11), min = twoDigits(p + 14);
+        if (hour < 0 || hour > 23 || min < 0 || min > 59) return false;
+
+        minuteStart = dayStart + hour * 3600 + min * 60;
+        std::memcpy(minutePrefix, p + 10, sizeof minutePrefix);
+        cachedMinute = true;
+    }
+
+    t = (minuteStart + sec) * ticksPerSecond + frac;
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef timestamp_hpp
+#define timestamp_hpp
+
+#include <time.h>
+#include "string_ref.hpp"
+
+// Converts Venmo's fixed-format timestamps ("2016-03-28T23:23:12Z", always UTC, always
+//   20 characters) to UNIX time with plain integer arithmetic, instead of going through
+//   strptime and timegm (both locale-aware, and timegm is surprisingly slow).
+//   Since consecutive events are nearly always in the same day (and usually the same
+//   minute), the start of the last decoded day and minute are cached, so that only
+//   the digits that actually changed get decoded.
+// Times come out as integer ticks since the Epoch: seconds by default, or finer (say,
+//   milliseconds) for a ticksPerSecond that is a power of ten. Fractional seconds
+//   ("2016-03-28T23:23:12.345Z") are accepted either way, and cut to whole ticks.
+class TimestampDecoder {
+public:
+    explicit TimestampDecoder(unsigned ticksPerSecond = 1)
+    : ticksPerSecond(ticksPerSecond), cachedDay(false), cachedMinute(false) {}
+
+    // returns false (leaving t alone) for anything but a well-formed, in-range timestamp
+    bool decode(StringRef s, time_t &t);
+    unsigned resolution() const { return ticksPerSecond; }
+
+    // days since the Epoch of a proleptic Gregorian date
+    static long daysFromCivil(long y, unsigned m, unsigned d);
+private:
+    unsigned ticksPerSecond;
+    bool cachedDay, cachedMinute;
+    char dayPrefix[10];    // "YYYY-MM-DD"
+    char minutePrefix[6];  // "THH:MM"
+    time_t dayStart, minuteStart;
+};
+
+#endif /* timestamp_hpp */
@@ -0,0 +1,203 @@
+#ifndef transaction_ring_hpp
+#define transaction_ring_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <time.h>
+
+// The transactions in the window, in a ring of buckets that each cover a fixed span of ticks.
+//   Every live transaction is less than a window's length older than the latest one, so
+//   a ring with one bucket per span of the window (and one more, for the span the window
+//   starts partway into) holds them all. The span grows with the window, so that there are
+//   never more than maxBuckets of them, whether the ticks are seconds or milliseconds.
+//   Each entry keeps its exact tick, and each bucket keeps its entries as a min-heap on the
+//   tick, so that the bucket the window's edge falls in can be evicted up to that tick; a
+//   bucket that is wholly out of the window just goes all at once. A bitmap marks the
+//   buckets with live entries, so that runs of empty ones are jumped over a word at a time.
+// The ring only records which edge was paid along at what tick; the edge map has the
+//   final word on each edge's time. When an edge is paid along again, its old entry is
+//   just left behind as stale (the bucket's live count goes down), and is dropped when it
+//   comes up for eviction or its bucket is reused.
+class TransactionRing {
+public:
+    using Edge = std::uint64_t;
+
+    static const std::size_t maxBuckets = 4096;
+
+    explicit TransactionRing(time_t windowTicks = 60)
+    : span((windowTicks + maxBuckets - 1) / maxBuckets),
+      buckets(static_cast<std::size_t>((windowTicks + span - 1) / span) + 1),
+      occupied((buckets.size() + 63) / 64, 0), liveTotal(0), oldestSpan(0), newest(0) {}
+
+    bool empty() const { return liveTotal == 0; }
+    // time of the latest live transaction; only meaningful if !empty()
+    time_t latest() const { return newest; }
+
+    // a transaction along edge at tick t; t must be within a window of latest()
+    void add(Edge edge, time_t t);
+    // The transaction along edge at tick t has been superseded (the edge was paid along
+    //   again); isCurrent(edge, time) tells whether an entry is still the edge's latest,
+    //   and is only needed if this was the latest transaction.
+    template <class IsCurrent>
+    void supersede(time_t t, IsCurrent isCurrent);
+
+    // Evict every live transaction at or before cutoff, calling evict(edge, time) for each
+    //   entry of those ticks; evict should check the edge's actual time against the given
+    //   one, to tell stale entries apart, and return whether it was current.
+    template <class EvictFn>
+    void evictThrough(time_t cutoff, EvictFn evict);
+private:
+    struct Entry {
+        time_t tick;
+        Edge edge;
+        bool operator<(const Entry &o) const { return tick > o.tick; } // for a min-heap
+    };
+    struct Bucket {
+        std::vector<Entry> entries; // live and stale alike, as a heap, earliest on top
+        time_t last = 0;            // the latest tick among them
+        int live = 0;               // how many of them are still current
+    };
+
+    // which span of ticks t is in, counting from time zero
+    time_t spanOf(time_t t) const { return t >= 0 ? t / span : -((span - 1 - t) / span); }
+    std::size_t indexOf(time_t s) const
+    {
+        const time_t n = static_cast<time_t>(buckets.size());
+        return static_cast<std::size_t>(((s % n) + n) % n);
+    }
+    // the first bucket at or after i with live entries, or buckets.size() if none
+    std::size_t nextOccupied(std::size_t i) const;
+    // the last bucket at or before i with live entries, or buckets.size() if none
+    std::size_t prevOccupied(std::size_t i) const;
+    void mark(std::size_t i) { occupied[i / 64] |= std::uint64_t(1) << (i % 64); }
+    void unmark(std::size_t i) { occupied[i / 64] &= ~(std::uint64_t(1) << (i % 64)); }
+    void clear(std::size_t i)
+    {
+        buckets[i].entries.clear();
+        buckets[i].live = 0;
+        unmark(i);
+    }
+
+    const time_t span;
+    std::vector<Bucket> buckets;
+    std::vector<std::uint64_t> occupied; // one bit per bucket: does it have live entries?
+    std::int64_t liveTotal;
+    time_t oldestSpan, newest; // no live transactions before span oldestSpan, or after newest
+};
+
+inline void TransactionRing::add(Edge edge, time_t t)
+{
+    time_t s = spanOf(t);
+    std::size_t i = indexOf(s);
+    Bucket &b = buckets[i];
+    if (b.live == 0) {
+        // whatever is left here is stale, maybe from a span long gone
+        b.entries.clear();
+        b.last = t;
+        mark(i);
+    } else if (t > b.last) {
+        b.last = t;
+    }
+    b.entries.push_back(Entry{t, edge});
+    std::push_heap(b.entries.begin(), b.entries.end());
+    b.live++;
+
+    if (liveTotal++ == 0) {
+        oldestSpan = s;
+        newest = t;
+    } else {
+        if (t > newest) newest = t;
+        if (s < oldestSpan) oldestSpan = s;
+    }
+}
+
+template <class IsCurrent>
+void TransactionRing::supersede(time_t t, IsCurrent isCurrent)
+{
+    std::size_t i = indexOf(spanOf(t));
+    if (--buckets[i].live == 0) unmark(i);
+    if (--liveTotal == 0 || t != newest) return;
+
+    // The latest is gone; the next latest is in the latest bucket that has anything live,
+    //   which has to be looked through (rarely: this takes a late payment along an edge
+    //   last paid along at the latest tick).
+    std::size_t j = prevOccupied(i);
+    if (j == buckets.size()) j = prevOccupied(buckets.size() - 1); // wrap around; there is one
+    time_t latest = 0;
+    bool found = false;
+    for (const Entry &e : buckets[j].entries) {
+        if ((!found || e.tick > latest) && isCurrent(e.edge, e.tick)) {
+            latest = e.tick;
+            found = true;
+        }
+    }
+    newest = latest;
+}
+
+inline std::size_t TransactionRing::nextOccupied(std::size_t i) const
+{
+    const std::size_t n = buckets.size();
+    if (i >= n) return n;
+    std::size_t w = i / 64;
+    std::uint64_t bits = occupied[w] & (~std::uint64_t(0) << (i % 64));
+    while (bits == 0) {
+        if (++w == occupied.size()) return n;
+        bits = occupied[w];
+    }
+    return w * 64 + __builtin_ctzll(bits);
+}
+
+inline std::size_t TransactionRing::prevOccupied(std::size_t i) const
+{
+    std::size_t w = i / 64;
+    std::uint64_t bits = occupied[w] & (~std::uint64_t(0) >> (63 - i % 64));
+    while (bits == 0) {
+        if (w-- == 0) return buckets.size();
+        bits = occupied[w];
+    }
+    return w * 64 + 63 - __builtin_clzll(bits);
+}
+
+template <class EvictFn>
+void TransactionRing::evictThrough(time_t cutoff, EvictFn evict)
+{
+    const std::size_t n = buckets.size();
+    const time_t cutoffSpan = spanOf(cutoff);
+    std::size_t i = indexOf(oldestSpan);
+    while (liveTotal > 0 && oldestSpan <= cutoffSpan) {
+        // skip to the next bucket with anything live in it, wrapping around at the end
+        std::size_t j = nextOccupied(i);
+        oldestSpan += static_cast<time_t>(j - i);
+        if (j == n) {
+            i = 0;
+            continue;
+        }
+        i = j;
+        if (oldestSpan > cutoffSpan) break;
+
+        Bucket &b = buckets[i];
+        if (b.last <= cutoff) { // all of it goes
+            for (const Entry &e : b.entries) evict(e.edge, e.tick);
+            liveTotal -= b.live;
+            clear(i);
+            oldestSpan++;
+            if (++i == n) i = 0;
+            continue;
+        }
+        // the cutoff is inside this one: just what is at or before it goes, and that's all
+        while (!b.entries.empty() && b.entries.front().tick <= cutoff) {
+            Entry e = b.entries.front();
+            std::pop_heap(b.entries.begin(), b.entries.end());
+            b.entries.pop_back();
+            if (evict(e.edge, e.tick)) {
+                liveTotal--;
+                if (--b.live == 0) clear(i);
+            }
+        }
+        break;
+    }
+}
+
+#endif /* transaction_ring_hpp */
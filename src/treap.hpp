@@ -8,102 +8,282 @@
 
 #ifndef Treap_h
 #define Treap_h
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <vector>
 #include <iostream>
 #include <cassert>
 #include <cstdlib>
-#include <memory>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
 #include <utility>
 
-// design decision: unique_ptrs help with memory management.
-// however they are subject to some restrictions: nodes may only have one owner
-// (by definition of unique_ptr), and either belong to one and only one tree,
-// or one and only one parent node.
-// In particular, we cannot use tree objects to refer to subtrees
+// design decision: nodes refer to their children by 32-bit index into the node arena of
+// the tree they belong to, rather than owning them through unique_ptrs. Links are half the
+// size, the nodes of a tree sit together in one block instead of all over the heap, and the
+// slots of removed nodes are recycled, so a tree that has reached its working size does no
+// heap allocation at all on updates.
+// A node belongs to one and only one tree (the one whose arena holds it), so tree objects
+// cannot refer to subtrees of other trees; moving nodes between trees copies them.
 // Actually, a node itself is the true recursive data structure; tree objects merely provide interface.
+using TreapIndex = std::uint32_t;
+const TreapIndex treapNull = ~TreapIndex(0); // the null link
+
 template <class Key, class Value, class Priority>
 struct TreapNode {
     Key key;
     Value val;
     Priority priority;
-    std::unique_ptr<TreapNode<Key,Value,Priority>> left;
-    std::unique_ptr<TreapNode<Key,Value,Priority>> right;
+    TreapIndex left;
+    TreapIndex right;
 
     // extra size field for maintaining order statistics
     int size;
 
-    TreapNode(const Key& k, const Value& v, Priority p, TreapNode<Key,Value,Priority>* l=nullptr, TreapNode<Key,Value,Priority>*r = nullptr)
-    : key(k), val(v), left(l), right(r), size(1), priority(p)
+    TreapNode(const Key& k, const Value& v, Priority p, TreapIndex l = treapNull, TreapIndex r = treapNull)
+    : key(k), val(v), priority(p), left(l), right(r), size(1)
     {}
 };
 
-// allow size computation with null nodes without extra conditionals cluttering up the code
-template <class Key, class Value, class Priority>
-inline int sz(const std::unique_ptr<TreapNode<Key,Value,Priority>> &t)
-{
-    return t?t->size:0;
-}
+// The default node allocator policy. An arena policy is a class template over the node type,
+//   handing out nodes by TreapIndex:
+//     Index create(args...)      construct a node, and return its index
+//     void destroy(Index)        give the node's slot back
+//     Node &operator[](Index)    (and const) get at a node; only good until the next create()
+//     std::size_t size() const   number of live nodes
+//     void reserve(std::size_t)  make room for that many nodes up front
+//     void clear()               drop every node at once
+// This one keeps all the nodes in one slab (a vector), and keeps a stack of the free slots;
+//   a freed slot is the next one to be reused, while it is still likely to be in cache.
+template <class Node>
+class SlabArena {
+public:
+    using Index = TreapIndex;
+
+    template <class... Args>
+    Index create(Args&&... args)
+    {
+        if (freeSlots.empty()) {
+            assert(nodes.size() < treapNull);
+            nodes.emplace_back(std::forward<Args>(args)...);
+            return static_cast<Index>(nodes.size() - 1);
+        }
+        Index i = freeSlots.back();
+        freeSlots.pop_back();
+        nodes[i] = Node(std::forward<Args>(args)...);
+        return i;
+    }
+    // the old contents of the slot linger until it is reused
+    void destroy(Index i) { freeSlots.push_back(i); }
+
+    Node &operator[](Index i) { return nodes[i]; }
+    const Node &operator[](Index i) const { return nodes[i]; }
+
+    std::size_t size() const { return nodes.size() - freeSlots.size(); }
+    void reserve(std::size_t n) { nodes.reserve(n); }
+    void clear() { nodes.clear(); freeSlots.clear(); }
+private:
+    std::vector<Node> nodes;      // the slab: live nodes and free slots alike
+    std::vector<Index> freeSlots; // most recently freed on top
+};
 
-template<class Key, class Value, class Priority>
+template<class Key, class Value, class Priority, template <class> class Arena = SlabArena>
 class Treap {
     // get rid of unwieldy typename
     using node = TreapNode<Key, Value, Priority>;
-
-    std::unique_ptr<node> root;
-    //void postorder_cleanup(node* curr);
-    void in_order(std::ostream &os, const std::unique_ptr<node>&) const;
+    static_assert(std::is_same<typename Arena<node>::Index, TreapIndex>::value, "nodes link by TreapIndex");
+
+    Arena<node> nodes;
+    TreapIndex root;
+    std::vector<TreapIndex> spine; // scratch space for build(), kept to reuse its memory
+
+    // allow size computation with null nodes without extra conditionals cluttering up the code
+    int sz(TreapIndex t) const { return t == treapNull ? 0 : nodes[t].size; }
+    void updateSize(TreapIndex t) { nodes[t].size = sz(nodes[t].left) + 1 + sz(nodes[t].right); }
+
+    // the workhorses, on subtrees of this tree
+    TreapIndex merge(TreapIndex lhs, TreapIndex rhs);
+    void split(TreapIndex t, const Key &k, bool inclusive, TreapIndex &lhs, TreapIndex &rhs);
+    // the link (within the subtree at the given one) to the topmost node with key k, or to
+    //   the null where it would be; every node with key k is below it
+    TreapIndex *locate(TreapIndex *at, const Key &k);
+    // put node x (on its own) into the subtree at the given link, where its key and priority
+    //   say it goes; everything on the way down gains a node
+    void attach(TreapIndex *at, TreapIndex x);
+    // copy a subtree of another tree into this one; returns the copy
+    TreapIndex transplant(const Treap<Key, Value, Priority, Arena> &from, TreapIndex t);
+    // give back the nodes of a subtree
+    void release(TreapIndex t);
+    // a tree of the (key, value) pairs of a range sorted by key, in linear time
+    template <class Iter>
+    TreapIndex build(Iter first, Iter last);
+    // the union of two subtrees, whatever their keys
+    TreapIndex unite(TreapIndex a, TreapIndex b);
+    // a subtree without the nodes whose keys are in a sorted range
+    template <class Iter>
+    TreapIndex subtract(TreapIndex t, Iter first, Iter last);
+
+    void in_order(std::ostream &os, TreapIndex) const;
 
     // order statistics
-    node* getNode(int index) const; // basic iterator function; we may extend this but for now, privatize
-    node* predecessor(const Key& k) const; // again, we may extend this for better functionality, but for now, privatize
+    TreapIndex getNode(int index) const; // basic iterator function, behind select() and the iterators
 public:
-    Treap() : root(nullptr) {}
-
-    // move construct from node: this is will be used to prune a tree at some child node
-    // implementation in terms of unique_ptr disallows tree objects to refer to a
-    // proper subtree of another tree: a tree object always contains a root whose pointer
-    // is not owned by anyone else, such as the child node of another tree.
-    // (to enable such semantics, we would use shared_ptr's)
-    Treap(std::unique_ptr<node>&&);
+    class const_iterator;
+    Treap() : root(treapNull) {}
 
+    // read N (key, value) pairs, in order of key
     Treap(std::istream& is, int N);
+    // from the (key, value) pairs of a range sorted by key, in linear time
+    template <class Iter>
+    Treap(Iter first, Iter last) : root(treapNull) { assign(first, last); }
 
-    // deep copy ops
-    Treap(const Treap<Key, Value, Priority>&);
-    Treap<Key, Value, Priority>& operator=(const Treap<Key, Value, Priority>&);
+    // deep copy ops: the arena is copied as a whole, links and all
+    Treap(const Treap<Key, Value, Priority, Arena>&) = default;
+    Treap<Key, Value, Priority, Arena>& operator=(const Treap<Key, Value, Priority, Arena>&) = default;
 
-    // move constructor: steal the pointer
-    Treap(Treap<Key, Value, Priority>&& other);
-    Treap<Key, Value, Priority>& operator=(Treap<Key, Value, Priority>&& other);
+    // move constructor: steal the arena
+    Treap(Treap<Key, Value, Priority, Arena>&& other);
+    Treap<Key, Value, Priority, Arena>& operator=(Treap<Key, Value, Priority, Arena>&& other);
 
     // allow default construction of the priority
-    Treap<Key, Value, Priority> &insert(const Key& k, const Value & data, Priority p=Priority());
-    Treap<Key, Value, Priority> &remove(const Key& k);
-    Treap<Key, Value, Priority> &merge(Treap<Key, Value, Priority> &rhs);
-    Treap<Key, Value, Priority> split(const Key &, bool inclusive=true);
-    Treap<Key, Value, Priority> split(std::unique_ptr<node> &curr);
-
-
+    Treap<Key, Value, Priority, Arena> &insert(const Key& k, const Value & data, Priority p=Priority());
+    Treap<Key, Value, Priority, Arena> &remove(const Key& k);
+    // every key of rhs must be greater than those of this tree; rhs is left empty
+    Treap<Key, Value, Priority, Arena> &merge(Treap<Key, Value, Priority, Arena> &rhs);
+    // keeps the keys up to k (inclusive or not) and returns the rest
+    Treap<Key, Value, Priority, Arena> split(const Key &, bool inclusive=true);
+
+    // change the key of a node from one value to another, keeping the node (and its value
+    //   and priority); it only gets cut out of and put back into the smallest subtree that
+    //   spans both keys, so the nearer the keys, the cheaper. Returns false if there's no such key.
+    bool rekey(const Key &from, const Key &to);
+    // the same for each (from, to) pair of a range, in turn
+    template <class Iter>
+    void rekey(Iter first, Iter last) { for ( ; first != last; ++first) rekey(first->first, first->second); }
+
+    // Batch operations, for sorted ranges of m keys; these take O(m log(n/m + 1)) on average,
+    //   so a big batch costs little more than one pass over the tree.
+    // replace the contents with the (key, value) pairs of a range sorted by key, in linear time
+    template <class Iter>
+    Treap<Key, Value, Priority, Arena> &assign(Iter first, Iter last)
+    { nodes.clear(); root = build(first, last); return *this; }
+    // insert the (key, value) pairs of a range sorted by key
+    template <class Iter>
+    Treap<Key, Value, Priority, Arena> &insertSorted(Iter first, Iter last)
+    { TreapIndex batch = build(first, last); root = unite(root, batch); return *this; }
+    // remove every node whose key is in a range of keys sorted in increasing order
+    template <class Iter>
+    Treap<Key, Value, Priority, Arena> &removeSorted(Iter first, Iter last)
+    { root = subtract(root, first, last); return *this; }
+
+    // make room for n nodes, so that growing to that size does not reallocate
+    void reserve(std::size_t n) { nodes.reserve(n); }
 
     void in_order(std::ostream &os) const { in_order(os,root); }
     int size() const { return sz(root); }
 
-    // subscripting
+    // subscripting; k must be in the tree
     const Value &operator[](const Key &k) const;
     std::pair<Key, Value> orderStatistic(int index) const
-    { node *res = getNode(index); return std::make_pair(res->key,res->val); } // array indexing
-
-    Value &operator[](const Key &k) { return const_cast<Value&>(static_cast<const Treap<Key, Value, Priority>&>(*this)[k]); }
-
-    // int getkey(node* curr) const ; // unnecessary for explicit treaps; however may be useful for computing order statistic
-    ~Treap();
+    { const node &res = nodes[getNode(index)]; return std::make_pair(res.key,res.val); } // array indexing
+
+    Value &operator[](const Key &k) { return const_cast<Value&>(static_cast<const Treap<Key, Value, Priority, Arena>&>(*this)[k]); }
+
+    bool empty() const { return root == treapNull; }
+
+    // Order statistics, all O(log n): ranks count from zero, and iterators are good until
+    //   the tree next changes.
+    // how many keys are less than k (so, the rank k would have)
+    int rank(const Key &k) const { return bound(k, false).pos; }
+    // how many keys are in [lo, hi)
+    int countRange(const Key &lo, const Key &hi) const { return hi < lo ? 0 : rank(hi) - rank(lo); }
+    // the key of the given rank, or end() if there's none
+    const_iterator select(int index) const
+    { return index >= 0 && index < size() ? const_iterator(this, getNode(index), index) : end(); }
+    // the first key not less than k, or greater than k, as for the standard containers
+    const_iterator lower_bound(const Key &k) const { return bound(k, false); }
+    const_iterator upper_bound(const Key &k) const { return bound(k, true); }
+    const_iterator find(const Key &k) const
+    { const_iterator it = lower_bound(k); return it != end() && !(k < *it) ? it : end(); }
+    // the greatest key less than k, and the least key greater than k; end() if there's none
+    const_iterator predecessor(const Key &k) const
+    { const_iterator it = lower_bound(k); return it.pos == 0 ? end() : --it; }
+    const_iterator successor(const Key &k) const { return upper_bound(k); }
+
+    // the keys of several ranks (sorted, and each less than size()), appended to keys, in
+    //   one walk down the tree
+    void select(const std::vector<int> &ranks, std::vector<Key> &keys) const
+    { if (!ranks.empty()) selectAll(root, 0, ranks.data(), ranks.data() + ranks.size(), keys); }
+
+    const_iterator begin() const { return select(0); }
+    const_iterator end() const { return const_iterator(this, treapNull, size()); }
+private:
+    // the first node whose key is not less than (or if strict, greater than) k
+    const_iterator bound(const Key &k, bool strict) const;
+    // the keys of the ranks in [first, last) in the subtree at t, whose keys have ranks from offset on
+    void selectAll(TreapIndex t, int offset, const int *first, const int *last, std::vector<Key> &keys) const;
+};
 
-    bool empty() { return !root;}
+// In-order iteration over the keys, without allocating: an iterator is a node and its rank.
+//   Stepping into a subtree just walks down it, and stepping up out of one looks the next
+//   rank up from the root, so a full pass costs O(n log n) at worst and much less in practice.
+template<class Key, class Value, class Priority, template <class> class Arena>
+class Treap<Key, Value, Priority, Arena>::const_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Key;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Key*;
+    using reference = const Key&;
+
+    const_iterator() : tree(nullptr), at(treapNull), pos(0) {}
+
+    const Key &operator*() const { return tree->nodes[at].key; }
+    const Key *operator->() const { return &tree->nodes[at].key; }
+    const Value &value() const { return tree->nodes[at].val; }
+    // how many keys come before this one
+    int rank() const { return pos; }
+
+    const_iterator &operator++()
+    {
+        TreapIndex right = tree->nodes[at].right;
+        pos++;
+        if (right != treapNull) {
+            // the leftmost node of the right subtree
+            at = right;
+            while (tree->nodes[at].left != treapNull) at = tree->nodes[at].left;
+        } else at = pos < tree->size() ? tree->getNode(pos) : treapNull;
+        return *this;
+    }
+    const_iterator &operator--()
+    {
+        TreapIndex left = at == treapNull ? treapNull : tree->nodes[at].left;
+        pos--;
+        if (left != treapNull) {
+            // the rightmost node of the left subtree
+            at = left;
+            while (tree->nodes[at].right != treapNull) at = tree->nodes[at].right;
+        } else at = tree->getNode(pos);
+        return *this;
+    }
+    const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+    const_iterator operator--(int) { const_iterator old = *this; --*this; return old; }
+
+    bool operator==(const const_iterator &rhs) const { return pos == rhs.pos && tree == rhs.tree; }
+    bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+private:
+    friend class Treap<Key, Value, Priority, Arena>;
+    const_iterator(const Treap<Key, Value, Priority, Arena> *tree, TreapIndex at, int pos) : tree(tree), at(at), pos(pos) {}
+
+    const Treap<Key, Value, Priority, Arena> *tree;
+    TreapIndex at; // treapNull at the end
+    int pos;
 };
 
-template <class Key, class Value, class Priority>
-inline std::ostream &operator <<(std::ostream&os, const Treap<Key, Value, Priority>& it)
+template <class Key, class Value, class Priority, template <class> class Arena>
+inline std::ostream &operator <<(std::ostream&os, const Treap<Key, Value, Priority, Arena>& it)
 {
     it.in_order(os);
     return os;
@@ -113,192 +293,340 @@ inline std::ostream &operator <<(std::ostream&os, const Treap<Key, Value, Priori
 
 // IMPLEMENTATIONS
 
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority>::Treap(std::unique_ptr<node>&& other)
-: root(std::move(other)) // move construct; null out the destination. incredibly useful for splitting
+// moving transfers the arena (and so every node) to the destination, and leaves the source empty
+template<class Key, class Value, class Priority, template <class> class Arena>
+Treap<Key, Value, Priority, Arena>::Treap(Treap<Key, Value, Priority, Arena>&& other)
+: nodes(std::move(other.nodes)), root(other.root)
 {
-    // possibly do rebalancing (although it seems safe to assume that a child node is already balanced
+    other.nodes.clear();
+    other.root = treapNull;
 }
 
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority>::~Treap() = default; // default destructor destroys elements in order of declaration
-
-// default move construction transfers ownership of the smart pointer to the destination
-
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority>::Treap(Treap<Key, Value, Priority>&& other) = default;
-/*: root(other.root)
+template<class Key, class Value, class Priority, template <class> class Arena>
+Treap<Key, Value, Priority, Arena>& Treap<Key, Value, Priority, Arena>::operator=(Treap<Key, Value, Priority, Arena> &&other)
 {
-    other.root = nullptr;
-} */
-
-
-// default move assignment swaps ownership with the expiring temporary
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority>& Treap<Key, Value, Priority>::operator=(Treap<Key, Value, Priority> &&other) = default;
-/*{
-    // swap; then the old tree that was *this will be deallocated by the destructor
-    node *temp = root;
-    root = other.root;
-    other.root=temp;
-
+    if (this != &other) {
+        nodes = std::move(other.nodes);
+        root = other.root;
+        other.nodes.clear();
+        other.root = treapNull;
+    }
     return *this;
-} */
+}
 
-/*void Treap::postorder_cleanup(node* curr) // this is taken care of by smart pointers
-{
-    if (!curr) return; // null: do nothing
-    postorder_cleanup(curr->left); // clean up left subtree
-    postorder_cleanup(curr->right); // clean up right subtree
-    delete curr; // clean up this node
-}*/
-
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority>& Treap<Key, Value, Priority>::insert(const Key& k, const Value &data, Priority p)
+// Inserting and removing walk down from the root, and only split or merge the subtree
+//   where the node goes in or comes out, which is small on average.
+template<class Key, class Value, class Priority, template <class> class Arena>
+Treap<Key, Value, Priority, Arena>& Treap<Key, Value, Priority, Arena>::insert(const Key& k, const Value &data, Priority p)
 {
-    // a one-element treap
-    Treap<Key, Value, Priority> temp(std::unique_ptr<node>(new node(k, data,p)));
-
-    // split the tree at index
-    auto right_tree = split(k);
-    // merge with the newly created node
-    merge(temp);
-    // merge with the right tree
-    merge(right_tree);
-
-    // (merge and split take care of all size management)
+    attach(&root, nodes.create(k, data, p));
     return *this;
 }
 
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority>& Treap<Key, Value, Priority>::remove(const Key& k)
+template<class Key, class Value, class Priority, template <class> class Arena>
+Treap<Key, Value, Priority, Arena>& Treap<Key, Value, Priority, Arena>::remove(const Key& k)
 {
-    // get the right tree
-    auto right_tree = split(k);
- 
-    // toss the actual element by splitting. The unused return value will call the destructor
+    TreapIndex *at = locate(&root, k);
+    if (*at == treapNull) return *this;
+
+    // every node with key k is in this subtree: cut them out by splitting twice, and give them back
     // the only time we use non-inclusive splitting
-    split(k, /* inclusive */ false);
-    // merge with the remainder
-    merge(right_tree);
-    
+    int before = nodes[*at].size;
+    TreapIndex less, rest, doomed, greater;
+    split(*at, k, /* inclusive */ false, less, rest);
+    split(rest, k, /* inclusive */ true, doomed, greater);
+    release(doomed);
+    // merge the remainder
+    TreapIndex remaining = merge(less, greater);
+
+    // everything on the way down lost as many
+    int removed = before - sz(remaining);
+    for (TreapIndex *up = &root; up != at; ) {
+        node &t = nodes[*up];
+        t.size -= removed;
+        up = k < t.key ? &t.left : &t.right;
+    }
+    *at = remaining;
     return *this;
 }
 
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority>& Treap<Key, Value, Priority>::merge(Treap<Key, Value, Priority> &rhs)
+template<class Key, class Value, class Priority, template <class> class Arena>
+Treap<Key, Value, Priority, Arena>& Treap<Key, Value, Priority, Arena>::merge(Treap<Key, Value, Priority, Arena> &rhs)
 {
     // if current tree is empty, move rhs to it.
     if (empty()) {
         *this = std::move(rhs);
+    } else if (!rhs.empty()) {
+        // the nodes of rhs live in its own arena: copy them over into ours
+        root = merge(root, transplant(rhs, rhs.root));
+        rhs = Treap<Key, Value, Priority, Arena>();
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Priority, template <class> class Arena>
+Treap<Key, Value, Priority, Arena> Treap<Key, Value, Priority, Arena>::split(const Key& index, bool inclusive)
+{
+    TreapIndex right_tree;
+    split(root, index, inclusive, root, right_tree);
+
+    // the right part goes to a tree of its own
+    Treap<Key, Value, Priority, Arena> res;
+    res.root = res.transplant(*this, right_tree);
+    release(right_tree);
+    return res;
+}
+
+template<class Key, class Value, class Priority, template <class> class Arena>
+bool Treap<Key, Value, Priority, Arena>::rekey(const Key& from, const Key& to)
+{
+    // walk down as long as both keys are on the same side: the node leaves and comes
+    //   back within the same subtree, so the sizes up here don't change
+    TreapIndex *link = &root;
+    while (*link != treapNull) {
+        node &t = nodes[*link];
+        if (t.key == from) break;
+        bool fromLeft = from < t.key;
+        if (fromLeft != (to < t.key)) break;
+        link = fromLeft ? &t.left : &t.right;
+    }
+
+    // find the node itself
+    TreapIndex *at = locate(link, from);
+    TreapIndex x = *at;
+    if (x == treapNull) return false;
+
+    // cut it out: everything on the way down loses a node, and its children take its place
+    for (TreapIndex *up = link; up != at; ) {
+        node &t = nodes[*up];
+        t.size--;
+        up = from < t.key ? &t.left : &t.right;
     }
-    if (!rhs.empty()) {
+    TreapIndex children = merge(nodes[x].left, nodes[x].right);
+    *at = children;
+
+    // and put it back with its new key
+    nodes[x].key = to;
+    attach(link, x);
+    return true;
+}
+
+// Both merge and split work top-down, without recursion, hanging subtrees off the open
+//   links of the results as they go. Every node's new size is known on the way down (split
+//   counts what goes left first), so there's no need to come back up.
+template<class Key, class Value, class Priority, template <class> class Arena>
+TreapIndex Treap<Key, Value, Priority, Arena>::merge(TreapIndex lhs, TreapIndex rhs)
+{
+    TreapIndex res;
+    TreapIndex *at = &res; // the open link the merged remainder goes to
+    while (true) {
+        if (lhs == treapNull) { *at = rhs; break; }
+        if (rhs == treapNull) { *at = lhs; break; }
+
         // must ensure priority is compatible
-        // right tree has higher priority
-        if (root->priority < rhs.root->priority) {
-            // cut off the left branch of rhs tree:
-            Treap<Key, Value, Priority> temp(std::move(rhs.root->left));
-            // merge with cut left branch; assume all its sizes are correct
-            merge(temp);
-            // reattach merged tree to left
-            rhs.root->left = std::move(root);
-            // update size
-            rhs.root->size = sz(rhs.root->left) + 1 + sz(rhs.root->right);
-            // call this the tree
-            *this = std::move(rhs);
+        // right tree has higher priority: it goes on top, and the rest is merged into its left branch
+        if (nodes[lhs].priority < nodes[rhs].priority) {
+            node &n = nodes[rhs];
+            n.size += nodes[lhs].size; // all of lhs ends up below it
+            *at = rhs;
+            at = &n.left;
+            rhs = n.left;
         }
-        // right tree has lower priority
+        // right tree has lower priority: this one goes on top, and the rest is merged into its right branch
         else {
-            // cut off right branch of this tree
-            Treap<Key, Value, Priority> temp(std::move(root->right));
-            // merge the cut branch with rhs; assume its sizes are correct
-            temp.merge(rhs);
-            // reattach merged tree to the right
-            root->right = std::move(temp.root);
-            // update size
-            root->size = sz(root->left)+1+sz(root->right);
+            node &n = nodes[lhs];
+            n.size += nodes[rhs].size;
+            *at = lhs;
+            at = &n.right;
+            lhs = n.right;
         }
     }
-    return *this;
+    return res;
 }
 
-template<class Key, class Value, class Priority>
-Treap<Key, Value, Priority> Treap<Key, Value, Priority>::split(const Key& index, bool inclusive)
+template<class Key, class Value, class Priority, template <class> class Arena>
+void Treap<Key, Value, Priority, Arena>::split(TreapIndex t, const Key& index, bool inclusive, TreapIndex &lhs, TreapIndex &rhs)
 {
-    Treap<Key, Value, Priority> res;
-    if (!empty()) {
-        bool rootIsLess = inclusive? (root->key <= index) : (root->key < index);
+    // first count the keys that go left; a node that goes left keeps exactly those of its
+    //   subtree, and one that goes right loses them
+    int goLeft = 0;
+    for (TreapIndex u = t; u != treapNull; ) {
+        const node &n = nodes[u];
+        bool rootIsLess = inclusive? (n.key <= index) : (n.key < index);
         if (rootIsLess) {
-            // cut off the right subtree
-            Treap<Key, Value, Priority> temp(std::move(root->right));
-
-            // recursively split the right subtree,
-            // store *its* right split in res and temp becomes *its* left split
-            res = temp.split(index,inclusive);
+            goLeft += sz(n.left) + 1;
+            u = n.right;
+        } else u = n.left;
+    }
 
-            // make the temp's left split as the right subree part of this left split
-            root->right = std::move(temp.root);
-            // update size
-            root->size =sz(root->left)+1+sz(root->right);
+    TreapIndex *l = &lhs, *r = &rhs; // the open links of the two results
+    while (t != treapNull) {
+        node &n = nodes[t];
+        bool rootIsLess = inclusive? (n.key <= index) : (n.key < index);
+        if (rootIsLess) {
+            // it goes left, with its left subtree; its right subtree is split next
+            n.size = goLeft;
+            goLeft -= sz(n.left) + 1;
+            *l = t;
+            l = &n.right;
+            t = n.right;
         } else {
-            // get (and cut off) the left subtree
-            Treap<Key, Value, Priority> temp(std::move(root->left));
+            // it goes right, with its right subtree; its left subtree is split next
+            n.size -= goLeft;
+            *r = t;
+            r = &n.left;
+            t = n.left;
+        }
+    }
+    *l = *r = treapNull;
+}
 
-            // split the left subtree, store *its* right split in res and temp becomes *its* left split
-            res = temp.split(index,inclusive);
-            // make this result the left subtree
-            root->left = std::move(res.root);
+template<class Key, class Value, class Priority, template <class> class Arena>
+Treap<Key, Value, Priority, Arena>::Treap(std::istream& is, int N)
+: root(treapNull)
+{
+    std::vector<std::pair<Key, Value>> items;
+    items.reserve(N > 0 ? N : 0);
+    std::pair<Key, Value> item;
+    for (int i = 0; i < N && is >> item.first >> item.second; i++) items.push_back(item);
+    assign(items.begin(), items.end());
+}
 
-            // update size
-            root->size =sz(root->left)+1+sz(root->right);
+template<class Key, class Value, class Priority, template <class> class Arena>
+template <class Iter>
+TreapIndex Treap<Key, Value, Priority, Arena>::build(Iter first, Iter last)
+{
+    // keep the right spine of the tree so far: each new node has the largest key yet, so it
+    //   goes at the bottom of the spine, above whatever it outranks (which becomes its left
+    //   subtree). A node that leaves the spine is finished, and gets its size then.
+    spine.clear();
+    for ( ; first != last; ++first) {
+        TreapIndex x = nodes.create(first->first, first->second, Priority());
+        TreapIndex below = treapNull;
+        while (!spine.empty() && nodes[spine.back()].priority < nodes[x].priority) {
+            below = spine.back();
+            spine.pop_back();
+            updateSize(below);
+        }
+        nodes[x].left = below;
+        if (!spine.empty()) nodes[spine.back()].right = x;
+        spine.push_back(x);
+    }
+    // what's left of the spine is finished last, bottom up
+    TreapIndex top = treapNull;
+    while (!spine.empty()) {
+        top = spine.back();
+        spine.pop_back();
+        updateSize(top);
+    }
+    return top;
+}
 
+template<class Key, class Value, class Priority, template <class> class Arena>
+TreapIndex Treap<Key, Value, Priority, Arena>::unite(TreapIndex a, TreapIndex b)
+{
+    if (a == treapNull) return b;
+    if (b == treapNull) return a;
+    // the root with the higher priority stays on top; the other tree is split around its key,
+    //   and each part goes in with the subtree on its side
+    if (nodes[a].priority < nodes[b].priority) std::swap(a, b);
+    TreapIndex l, r;
+    split(b, nodes[a].key, /* inclusive */ true, l, r);
+    TreapIndex left = unite(nodes[a].left, l);
+    TreapIndex right = unite(nodes[a].right, r);
+    nodes[a].left = left;
+    nodes[a].right = right;
+    updateSize(a);
+    return a;
+}
 
-            // swap out. Want this tree to be the left result,
+template<class Key, class Value, class Priority, template <class> class Arena>
+template <class Iter>
+TreapIndex Treap<Key, Value, Priority, Arena>::subtract(TreapIndex t, Iter first, Iter last)
+{
+    if (t == treapNull || first == last) return t;
+    // the keys on either side go down the corresponding subtree (equal keys may be on both)
+    Iter lo = std::lower_bound(first, last, nodes[t].key);
+    Iter hi = std::upper_bound(lo, last, nodes[t].key);
+    TreapIndex left = subtract(nodes[t].left, first, hi);
+    TreapIndex right = subtract(nodes[t].right, lo, last);
+    if (lo != hi) {
+        nodes.destroy(t);
+        return merge(left, right);
+    }
+    nodes[t].left = left;
+    nodes[t].right = right;
+    updateSize(t);
+    return t;
+}
 
-            // so move the root to the return value (right result)
-            res = std::move(*this);
+template<class Key, class Value, class Priority, template <class> class Arena>
+TreapIndex *Treap<Key, Value, Priority, Arena>::locate(TreapIndex *at, const Key &k)
+{
+    while (*at != treapNull && !(nodes[*at].key == k)) at = k < nodes[*at].key ? &nodes[*at].left : &nodes[*at].right;
+    return at;
+}
 
-            // set this tree to temp
-            *this = std::move(temp);
-        }
+template<class Key, class Value, class Priority, template <class> class Arena>
+void Treap<Key, Value, Priority, Arena>::attach(TreapIndex *at, TreapIndex x)
+{
+    // walk down until its priority beats the subtree's, then split that subtree around it
+    //   (equal keys go before it)
+    const Key &k = nodes[x].key;
+    while (*at != treapNull && !(nodes[*at].priority < nodes[x].priority)) {
+        node &t = nodes[*at];
+        t.size++;
+        at = k < t.key ? &t.left : &t.right;
     }
-    return res;
+    split(*at, k, /* inclusive */ true, nodes[x].left, nodes[x].right);
+    updateSize(x);
+    *at = x;
+}
+
+template<class Key, class Value, class Priority, template <class> class Arena>
+TreapIndex Treap<Key, Value, Priority, Arena>::transplant(const Treap<Key, Value, Priority, Arena> &from, TreapIndex t)
+{
+    if (t == treapNull) return treapNull;
+    const node &n = from.nodes[t];
+    TreapIndex l = transplant(from, n.left);
+    TreapIndex r = transplant(from, n.right);
+    TreapIndex copy = nodes.create(n.key, n.val, n.priority, l, r);
+    nodes[copy].size = n.size;
+    return copy;
+}
+
+template<class Key, class Value, class Priority, template <class> class Arena>
+void Treap<Key, Value, Priority, Arena>::release(TreapIndex t)
+{
+    if (t == treapNull) return;
+    release(nodes[t].left);
+    release(nodes[t].right);
+    nodes.destroy(t);
 }
 
-//template<class Key, class Value, class Priority>
-//int Treap<Key,Value,Priority>::getkey(node* theNode) const
-//{ /*
-//   node * curr = root.get();
-//   while (true) {
-//   while (curr)
-//   } */
-//    // we have to do inorder traversal (linear time)
-//    // if we store the parents, this can be accomplished in logarithmic time
-//    return 0;
-//}
 // Array indexing operation: the implicit key
 // Basic strategy: count the predecessors using stored size information
 
-template <class Key, class Value, class Priority>
-typename Treap<Key, Value, Priority>::node *Treap<Key, Value, Priority>::getNode(int index) const
+template <class Key, class Value, class Priority, template <class> class Arena>
+TreapIndex Treap<Key, Value, Priority, Arena>::getNode(int index) const
 {
-    // use raw pointers: here, we are using pointers in their *iterator* sense.
-    node *curr = root.get();
+    // indices are used in their *iterator* sense here.
+    TreapIndex curr = root;
     int count = 0; // current count so far
 
     while (true) {
-        int leftCount = sz(curr->left); // get size of the left node
+        int leftCount = sz(nodes[curr].left); // get size of the left node
         // add the size of the left subtree to the current count
         // if this exceeds the index, adjust and move left until it doesn't exceed
         while (leftCount + count > index) {
-            curr = curr->left.get();
-            leftCount = sz(curr->left);
+            curr = nodes[curr].left;
+            leftCount = sz(nodes[curr].left);
         }
         count += leftCount; // add this count on
         // if moving left overshoots the mark, then there must be some right children to consider
         if (count < index) {
             count++;
-            curr = curr->right.get(); // move right, and loop again (to find leftmost)
+            curr = nodes[curr].right; // move right, and loop again (to find leftmost)
         }
         else break; // otherwise, we've landed spot on
     }
@@ -306,22 +634,65 @@ typename Treap<Key, Value, Priority>::node *Treap<Key, Value, Priority>::getNode
     return curr;
 }
 
-template <class Key, class Value, class Priority>
-typename Treap<Key, Value, Priority>::node *Treap<Key, Value, Priority>::predecessor(const Key& k) const
+template <class Key, class Value, class Priority, template <class> class Arena>
+typename Treap<Key, Value, Priority, Arena>::const_iterator Treap<Key, Value, Priority, Arena>::bound(const Key& k, bool strict) const
 {
-    return nullptr;
+    // the candidate is the last node we went left at; everything we went right past comes before it
+    TreapIndex curr = root, best = treapNull;
+    int count = 0;
+    while (curr != treapNull) {
+        const node &n = nodes[curr];
+        if (strict ? k < n.key : !(n.key < k)) {
+            best = curr;
+            curr = n.left;
+        } else {
+            count += sz(n.left) + 1;
+            curr = n.right;
+        }
+    }
+    // by the end, count has passed every key before the candidate
+    return const_iterator(this, best, count);
 }
 
+template <class Key, class Value, class Priority, template <class> class Arena>
+void Treap<Key, Value, Priority, Arena>::selectAll(TreapIndex t, int offset, const int *first, const int *last, std::vector<Key> &keys) const
+{
+    // the ranks before this node's go left, the ones after it go right
+    while (first != last) {
+        const node &n = nodes[t];
+        int here = offset + sz(n.left);
+        const int *mid = first;
+        while (mid != last && *mid < here) mid++;
+        if (mid != first) selectAll(n.left, offset, first, mid, keys);
+        if (mid != last && *mid == here) {
+            keys.push_back(n.key);
+            mid++;
+        }
+        // and the right subtree is this loop's next round
+        first = mid;
+        offset = here + 1;
+        t = n.right;
+    }
+}
 
-template <class Key, class Value, class Priority>
-void Treap<Key, Value, Priority>::in_order(std::ostream &os, const std::unique_ptr<node>& curr) const
+template <class Key, class Value, class Priority, template <class> class Arena>
+const Value &Treap<Key, Value, Priority, Arena>::operator[](const Key& k) const
+{
+    const_iterator it = find(k);
+    assert(it != end());
+    return it.value();
+}
+
+
+template <class Key, class Value, class Priority, template <class> class Arena>
+void Treap<Key, Value, Priority, Arena>::in_order(std::ostream &os, TreapIndex curr) const
 {
-    if (!curr) {
+    if (curr == treapNull) {
         return;
     }
-    in_order(os,curr->left);
-    os << curr->val << ' ';
-    in_order(os,curr->right);
+    in_order(os,nodes[curr].left);
+    os << nodes[curr].val << ' ';
+    in_order(os,nodes[curr].right);
 }
 
 
@@ -0,0 +1,243 @@
+#include "venmo_parser.hpp"
+#include <exception>
+#include "json.hpp"
+
+namespace {
+    inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    inline const char *skipSpace(const char *p, const char *e)
+    {
+        while (p < e && isSpace(*p)) ++p;
+        return p;
+    }
+
+    // p points just past an opening quote; returns the closing quote, or null if the string
+    //   is unterminated or has anything (escapes, control characters) json.hpp must deal with
+    inline const char *scanString(const char *p, const char *e)
+    {
+        for ( ; p < e; ++p) {
+            unsigned char c = *p;
+            if (c == '"') return p;
+            if (c == '\\' || c < 0x20) return nullptr;
+        }
+        return nullptr;
+    }
+
+    inline bool keyIs(StringRef key, const char *name)
+    {
+        return key == StringRef(name, std::strlen(name));
+    }
+
+    // true if [p, e) is a lone separator character padded with whitespace
+    inline bool isSeparator(const char *p, const char *e, char sep)
+    {
+        p = skipSpace(p, e);
+        return p < e && *p == sep && skipSpace(p + 1, e) == e;
+    }
+
+    // JSON syntax checking, without building anything. Each of these returns the end of
+    //   what it skipped, or null if it isn't valid. They're a little more lenient than
+    //   json.hpp (control characters and lone surrogates in strings), so json.hpp still
+    //   gets the last word on those.
+    const int maxDepth = 512;
+
+    inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    inline bool isHexDigit(char c)
+    {
+        return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    // p points just past the opening quote
+    const char *skipString(const char *p, const char *e)
+    {
+        while (p < e) {
+            char c = *p++;
+            if (c == '"') return p;
+            if (c != '\\') continue;
+            if (p == e) return nullptr;
+            c = *p++;
+            if (c == 'u') {
+                for (int i = 0; i < 4; i++, p++)
+                    if (p == e || !isHexDigit(*p)) return nullptr;
+            } else if (c == '\0' || !std::strchr("\"\\/bfnrt", c)) {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    const char *skipDigits(const char *p, const char *e)
+    {
+        while (p < e && isDigit(*p)) ++p;
+        return p;
+    }
+
+    const char *skipNumber(const char *p, const char *e)
+    {
+        if (p < e && *p == '-') ++p;
+        if (p == e || !isDigit(*p)) return nullptr;
+        p = *p == '0' ? p + 1 : skipDigits(p, e);
+        if (p < e && *p == '.') {
+            const char *frac = ++p;
+            if ((p = skipDigits(p, e)) == frac) return nullptr;
+        }
+        if (p < e && (*p == 'e' || *p == 'E')) {
+            if (++p < e && (*p == '+' || *p == '-')) ++p;
+            const char *exp = p;
+            if ((p = skipDigits(p, e)) == exp) return nullptr;
+        }
+        return p;
+    }
+
+    const char *skipLiteral(const char *p, const char *e, const char *word)
+    {
+        std::size_t n = std::strlen(word);
+        return std::size_t(e - p) >= n && std::memcmp(p, word, n) == 0 ? p + n : nullptr;
+    }
+
+    const char *skipValue(const char *p, const char *e, int depth)
+    {
+        p = skipSpace(p, e);
+        if (p == e || depth > maxDepth) return nullptr;
+        switch (*p) {
+            case '"': return skipString(p + 1, e);
+            case 't': return skipLiteral(p, e, "true");
+            case 'f': return skipLiteral(p, e, "false");
+            case 'n': return skipLiteral(p, e, "null");
+            case '{':
+            case '[': {
+                const bool object = *p == '{';
+                const char close = object ? '}' : ']';
+                p = skipSpace(p + 1, e);
+                if (p < e && *p == close) return p + 1;
+                while (true) {
+                    if (object) {
+                        p = skipSpace(p, e);
+                        if (p == e || *p != '"' || !(p = skipString(p + 1, e))) return nullptr;
+                        p = skipSpace(p, e);
+                        if (p == e || *p++ != ':') return nullptr;
+                    }
+                    if (!(p = skipValue(p, e, depth + 1))) return nullptr;
+                    p = skipSpace(p, e);
+                    if (p == e) return nullptr;
+                    if (*p == close) return p + 1;
+                    if (*p++ != ',') return nullptr;
+                }
+            }
+            default: return skipNumber(p, e);
+        }
+    }
+
+    // the whole line is one JSON value, give or take some whitespace
+    bool isValidJson(StringRef line)
+    {
+        const char *end = skipValue(line.begin(), line.end(), 0);
+        return end && skipSpace(end, line.end()) == line.end();
+    }
+}
+
+bool VenmoParser::parseFast(StringRef line, VenmoRecord &rec)
+{
+    const char *p = line.begin(), *e = line.end();
+    bool haveTime = false, haveActor = false, haveTarget = false;
+
+    p = skipSpace(p, e);
+    if (p == e || *p++ != '{') return false;
+
+    while (true) {
+        // "key"
+        p = skipSpace(p, e);
+        if (p == e || *p++ != '"') return false;
+        const char *keyEnd = scanString(p, e);
+        if (!keyEnd) return false;
+        StringRef key(p, keyEnd);
+        p = skipSpace(keyEnd + 1, e);
+        if (p == e || *p++ != ':') return false;
+
+        // "value" (only strings are expected here)
+        p = skipSpace(p, e);
+        if (p == e || *p++ != '"') return false;
+        const char *valEnd = scanString(p, e);
+        if (!valEnd) return false;
+        StringRef val(p, valEnd);
+        p = skipSpace(valEnd + 1, e);
+
+        // any key outside the schema, or a repeated one, is left to the full parser
+        if (keyIs(key, "created_time") && !haveTime) { rec.createdTime = val; haveTime = true; }
+        else if (keyIs(key, "actor") && !haveActor) { rec.actor = val; haveActor = true; }
+        else if (keyIs(key, "target") && !haveTarget) { rec.target = val; haveTarget = true; }
+        else return false;
+
+        if (p == e) return false;
+        if (*p == ',') { ++p; continue; }
+        if (*p++ != '}') return false;
+        break;
+    }
+    // nothing but whitespace may follow the object
+    return haveTime && haveActor && haveTarget && skipSpace(p, e) == e;
+}
+
+bool VenmoParser::parseIndexed(StringRef line, const RecordIndex &idx, VenmoRecord &rec)
+{
+    // the three "key": "value" pairs account for all twelve quotes, so only the
+    //   (short) gaps between them are left to check
+    if (idx.numQuotes != RecordIndex::maxQuotes || idx.hasBackslash || idx.hasControl) return false;
+    const char *p = line.data;
+    const std::uint32_t *q = idx.quotes;
+    bool haveTime = false, haveActor = false, haveTarget = false;
+
+    if (!isSeparator(p, p + q[0], '{')) return false;
+    for (int i = 0; i < 3; i++, q += 4) {
+        if (!isSeparator(p + q[1] + 1, p + q[2], ':')) return false;
+        const char *next = i < 2 ? p + q[4] : line.end();
+        if (!isSeparator(p + q[3] + 1, next, i < 2 ? ',' : '}')) return false;
+
+        StringRef key(p + q[0] + 1, p + q[1]);
+        StringRef val(p + q[2] + 1, p + q[3]);
+        if (keyIs(key, "created_time") && !haveTime) { rec.createdTime = val; haveTime = true; }
+        else if (keyIs(key, "actor") && !haveActor) { rec.actor = val; haveActor = true; }
+        else if (keyIs(key, "target") && !haveTarget) { rec.target = val; haveTarget = true; }
+        else return false;
+    }
+    return true;
+}
+
+RecordStatus VenmoParser::parse(StringRef line, const RecordIndex &idx, VenmoRecord &rec)
+{
+    // control characters might be harmless whitespace, which only the bytewise path can tell
+    if (idx.hasControl ? parseFast(line, rec) : parseIndexed(line, idx, rec)) return RecordStatus::Ok;
+    return parseFallback(line, rec);
+}
+
+RecordStatus VenmoParser::parse(StringRef line, VenmoRecord &rec)
+{
+    if (parseFast(line, rec)) return RecordStatus::Ok;
+    return parseFallback(line, rec);
+}
+
+RecordStatus VenmoParser::parseFallback(StringRef line, VenmoRecord &rec)
+{
+    // the slow but thorough way: build the DOM and pull the fields out of it.
+    //   json.hpp can only complain by throwing, so it only gets what passes the syntax check
+    if (!isValidJson(line)) return RecordStatus::BadJson;
+    nlohmann::json j;
+    try {
+        j = nlohmann::json::parse(line.str());
+    } catch (std::exception&) {
+        return RecordStatus::BadJson; // whatever the syntax check lets through (bad surrogates)
+    }
+
+    if (!j.is_object()) return RecordStatus::MissingField;
+    auto t = j.find("created_time"), a = j.find("actor"), g = j.find("target");
+    if (t == j.end() || a == j.end() || g == j.end()) return RecordStatus::MissingField;
+    if (!t->is_string() || !a->is_string() || !g->is_string()) return RecordStatus::MissingField;
+    createdTime = t->get<std::string>();
+    actor = a->get<std::string>();
+    target = g->get<std::string>();
+
+    rec.createdTime = StringRef(createdTime.data(), createdTime.size());
+    rec.actor = StringRef(actor.data(), actor.size());
+    rec.target = StringRef(target.data(), target.size());
+    return RecordStatus::Ok;
+}
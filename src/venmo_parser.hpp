@@ -0,0 +1,44 @@
+#ifndef venmo_parser_hpp
+#define venmo_parser_hpp
+
+#include <string>
+#include "record_status.hpp"
+#include "string_ref.hpp"
+#include "structural_scan.hpp"
+
+// The only three fields of a Venmo payment we care about, still in their raw text form.
+//   These are views: into the input record if the fast path took it, otherwise into
+//   the parser's own storage, so they are only good until the next parse.
+struct VenmoRecord {
+    StringRef createdTime;
+    StringRef actor;
+    StringRef target;
+};
+
+// Schema-specialized reader for Venmo records.
+//   Nearly every record is a flat object of exactly created_time, actor and target,
+//   all plain strings, so we pick those straight out of the raw bytes (in any key order,
+//   with any whitespace) without building a JSON DOM. Anything outside that shape
+//   (escapes, extra or duplicate fields, non-string values) is handed to json.hpp,
+//   so the results are the same as before, only faster in the common case.
+//   Nothing is thrown for a bad record: it is syntax-checked before json.hpp gets to see it.
+class VenmoParser {
+public:
+    // RecordStatus::BadJson if the record turns out not to be valid JSON, and
+    //   RecordStatus::MissingField if a field is missing or not a string; rec is only
+    //   filled in for RecordStatus::Ok
+    RecordStatus parse(StringRef line, VenmoRecord &rec);
+    // same, but with the quote positions already found by the structural scanner
+    RecordStatus parse(StringRef line, const RecordIndex &idx, VenmoRecord &rec);
+
+    // the DOM-free paths by themselves; they return false if the record needs the full parser
+    static bool parseFast(StringRef line, VenmoRecord &rec);
+    static bool parseIndexed(StringRef line, const RecordIndex &idx, VenmoRecord &rec);
+private:
+    RecordStatus parseFallback(StringRef line, VenmoRecord &rec);
+
+    // backing storage for records that went through json.hpp
+    std::string createdTime, actor, target;
+};
+
+#endif /* venmo_parser_hpp */
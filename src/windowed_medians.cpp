@@ -0,0 +1,40 @@
+#include "windowed_medians.hpp"
+
+WindowedMedians::WindowedMedians(const std::vector<time_t> &windowLengths, MedianBackend backend,
+                                 time_t maxLateness, unsigned ticksPerSecond)
+: timeDecoder(ticksPerSecond), latestTime(0), started(false)
+{
+    windows.reserve(windowLengths.size());
+    for (time_t w : windowLengths) windows.emplace_back(backend, w, maxLateness);
+}
+
+RecordStatus WindowedMedians::insert(const VenmoRecord &r)
+{
+    // get date and time of transaction as ticks since the Epoch; skip it if garbled
+    time_t transactionTime;
+    if (!timeDecoder.decode(r.createdTime, transactionTime)) return RecordStatus::BadTimestamp;
+    return insert(transactionTime, r.actor, r.target);
+}
+
+RecordStatus WindowedMedians::insert(time_t transactionTime, StringRef actorName, StringRef targetName)
+{
+    // a payment needs two different, named people; skip it otherwise
+    if (actorName.empty()) return RecordStatus::EmptyActor;
+    if (targetName.empty()) return RecordStatus::EmptyTarget;
+    if (actorName == targetName) return RecordStatus::SelfPayment;
+    
+    // from here on, people are just numbers (the actor first, so that ids are in input order)
+    VertexId actor = vertexNames.intern(actorName);
+    VertexId target = vertexNames.intern(targetName);
+    return insert(transactionTime, actor, target);
+}
+
+RecordStatus WindowedMedians::insert(time_t transactionTime, VertexId actor, VertexId target)
+{
+    if (actor == target) return RecordStatus::SelfPayment;
+    if (!started || transactionTime > latestTime) latestTime = transactionTime;
+    started = true;
+    // past these checks, no window can turn the record down (a late one still counts as Ok)
+    for (MedianDegreeStruct &w : windows) w.insert(transactionTime, actor, target);
+    return RecordStatus::Ok;
+}
@@ -0,0 +1,52 @@
+#ifndef windowed_medians_hpp
+#define windowed_medians_hpp
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include <time.h>
+#include "median_degree.hpp"
+#include "name_table.hpp"
+#include "record_status.hpp"
+#include "string_ref.hpp"
+#include "timestamp.hpp"
+#include "venmo_parser.hpp"
+
+// The same stream of payments, watched through several windows at once (say, a minute,
+//   five minutes and an hour). Timestamps are decoded and names interned once, here, and
+//   every window gets the same transaction by vertex id; each keeps its own edges and its
+//   own median structure.
+class WindowedMedians {
+public:
+    using VertexId = MedianDegreeStruct::VertexId;
+
+    // one window per length, in the order given; lengths and maxLateness are in ticks,
+    //   ticksPerSecond to the second, as for MedianDegreeStruct
+    WindowedMedians(const std::vector<time_t> &windowLengths, MedianBackend backend,
+                    time_t maxLateness = std::numeric_limits<time_t>::max(), unsigned ticksPerSecond = 1);
+
+    // same as MedianDegreeStruct's; a record is skipped (or not) for every window alike
+    RecordStatus insert(const VenmoRecord& r);
+    RecordStatus insert(time_t transactionTime, StringRef actor, StringRef target);
+    RecordStatus insert(time_t transactionTime, VertexId actor, VertexId target);
+
+    // the latest event time (in ticks) of any payment so far; 0 before the first
+    time_t latest() const { return latestTime; }
+
+    // see MedianDegreeStruct::trackTopDegrees()
+    void trackTopDegrees() { for (MedianDegreeStruct &w : windows) w.trackTopDegrees(); }
+
+    std::size_t size() const { return windows.size(); }
+    const MedianDegreeStruct &window(std::size_t i) const { return windows[i]; }
+
+    // everyone seen so far, in every window; a replay can intern its whole dictionary up front
+    NameTable &names() { return vertexNames; }
+private:
+    TimestampDecoder timeDecoder;
+    NameTable vertexNames;
+    std::vector<MedianDegreeStruct> windows;
+    time_t latestTime;
+    bool started;
+};
+
+#endif /* windowed_medians_hpp */